@@ -0,0 +1,94 @@
+﻿#define TEST(condition, num) if (condition) std::cout << "+ Test " << num << " passed!\n"; else std::cout << "- Test " << num << " failed :(\n";
+
+#include <StdULR.hpp>
+#include <iostream>
+#include <chrono>
+
+const size_t NUM_INSTANCES = 1000000;
+
+BEGIN_ULR_EXPORT
+
+void InitAssembly(ULRAPIImpl* ulr)
+{
+	internal_api = ulr;
+}
+
+void overload0_ns0_Program_ctor(char* self) {}
+
+void overload0_ns0_Node_ctor(char* self)
+{
+	*(sizeof_ns1_System_Int32*) (self+16) = -1;
+}
+
+void overload1_ns0_Node_ctor(char* self, char* next, sizeof_ns1_System_Int32 value)
+{
+	*(char**) (self+8) = next;
+	*(sizeof_ns1_System_Int32*) (self+16) = value;
+
+	ULR_WRITE_BARRIER(self);
+}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Main(char* argv)
+{
+	char* framebase;
+
+	asm(
+		"mov %0, rbp\n\t"
+		:"=r"(framebase)
+	);
+
+	framebase-=sizeof(char*); // skip all "framebase" itself;
+
+	internal_api->InitGCLocalVarRoot((char**) framebase);
+
+	Type* node_type = internal_api->GetType("[]Node");
+	Type* SystemInt32Type = internal_api->GetType("[System]Int32");
+
+	char* node = internal_api->CreateInstance(node_type);
+
+	TEST(node && internal_api->GetTypeOf(node) == node_type && *(sizeof_ns1_System_Int32*) (node+16) == -1, 1);
+	TEST(*(char**) (node+8) == nullptr, 2); // the type holds a ref, so it is zeroed before the ctor runs
+
+	Activator* activator = internal_api->GetActivator(node_type);
+
+	TEST(activator->zero_init && activator->alloc_size == node_type->size && activator->ctors.size() == 1, 3);
+
+	Type* argsig[] = { node_type, SystemInt32Type };
+	sizeof_ns1_System_Int32 value = 5;
+	void* args[] = { &node, &value };
+
+	char* head = internal_api->CreateInstance(node_type, argsig, 2, args);
+
+	TEST(head && *(char**) (head+8) == node && *(sizeof_ns1_System_Int32*) (head+16) == 5 && activator->last_ctor == activator->ctors[0], 4);
+
+	Type* wrongsig[] = { SystemInt32Type };
+
+	TEST(!internal_api->CreateInstance(node_type, wrongsig, 1, args) && !internal_api->GetCtor(node_type, { SystemInt32Type }), 5);
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < NUM_INSTANCES; i++) internal_api->CreateInstance(node_type);
+
+	auto end = std::chrono::steady_clock::now();
+
+	std::cout << "CreateInstance: " << std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count()/NUM_INSTANCES << " ns/instance\n";
+
+	TEST(internal_api->GetActivator(node_type) == activator, 6);
+
+	return 0;
+}
+
+char ulrmeta[] = "pc[]Program:[System]Object,$8;.ctor p();.entr s[System]Int32 Main([System]String[]);\npc[]Node:[System]Object,$24;.ctor p();.ctor p([]Node,[System]Int32);.fldv p[]Node Next;.fldv p[System]Int32 Value;\n";
+
+void* ulraddr[] = {
+	(void*) overload0_ns0_Program_ctor,
+	(void*) overload0_ns0_Program_Main,
+	(void*) overload0_ns0_Node_ctor,
+	(void*) overload1_ns0_Node_ctor,
+	(void*) 8,
+	(void*) 16
+};
+
+char* ulrdeps[] = { nullptr };
+
+END_ULR_EXPORT
@@ -0,0 +1,133 @@
+﻿#define TEST(condition, num) if (condition) std::cout << "+ Test " << num << " passed!\n"; else std::cout << "- Test " << num << " failed :(\n";
+
+#include <StdULR.hpp>
+#include <iostream>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+const size_t ALLOCS_PER_THREAD = 250000;
+const size_t OBJECT_SIZE = sizeof(Type*)+24;
+
+// the allocation path that AllocateObjectNoGC took before the size class heap existed
+std::mutex old_alloc_lock;
+std::map<char*, size_t> old_allocated_objs;
+
+char* OldAllocate(size_t size)
+{
+	old_alloc_lock.lock();
+
+	char* mem = (char*) malloc(size);
+
+	old_allocated_objs.emplace(mem, size);
+
+	old_alloc_lock.unlock();
+
+	return mem;
+}
+
+// returns the number of successful allocations
+size_t RunThreads(size_t num_threads, bool use_heap, Type* objtype, std::vector<char*>& samples)
+{
+	std::vector<std::thread> threads;
+	std::vector<size_t> counts(num_threads, 0);
+	std::vector<char*> thread_samples(num_threads, nullptr);
+
+	for (size_t t = 0; t < num_threads; t++)
+	{
+		threads.emplace_back([t, use_heap, objtype, &counts, &thread_samples]() {
+			for (size_t i = 0; i < ALLOCS_PER_THREAD; i++)
+			{
+				char* obj = use_heap ? internal_api->AllocateObjectNoGC(OBJECT_SIZE) : OldAllocate(OBJECT_SIZE);
+
+				if (!obj) continue;
+
+				*(Type**) obj = objtype;
+
+				counts[t]++;
+
+				if (i == ALLOCS_PER_THREAD/2) thread_samples[t] = obj;
+			}
+		});
+	}
+
+	for (auto& thread : threads) thread.join();
+
+	samples.insert(samples.end(), thread_samples.begin(), thread_samples.end());
+
+	size_t total = 0;
+
+	for (size_t count : counts) total+=count;
+
+	return total;
+}
+
+BEGIN_ULR_EXPORT
+
+void InitAssembly(ULRAPIImpl* ulr)
+{
+	internal_api = ulr;
+}
+
+void overload0_ns0_Program_ctor(char* self) {}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Main(char* argv)
+{
+	Type* objtype = internal_api->GetType("[]Program");
+
+	bool all_allocated = true;
+	std::vector<char*> samples;
+
+	for (size_t num_threads : { 1, 4, 16 })
+	{
+		std::vector<char*> old_samples;
+
+		auto old_start = std::chrono::steady_clock::now();
+
+		all_allocated = (RunThreads(num_threads, false, objtype, old_samples) == num_threads*ALLOCS_PER_THREAD) && all_allocated;
+
+		auto old_end = std::chrono::steady_clock::now();
+
+		all_allocated = (RunThreads(num_threads, true, objtype, samples) == num_threads*ALLOCS_PER_THREAD) && all_allocated;
+
+		auto heap_end = std::chrono::steady_clock::now();
+
+		size_t total = num_threads*ALLOCS_PER_THREAD;
+
+		std::cout
+			<< num_threads << " threads: malloc + map "
+			<< (total*1000)/std::chrono::duration_cast<std::chrono::microseconds>(old_end-old_start).count()
+			<< " allocs/ms, size class heap "
+			<< (total*1000)/std::chrono::duration_cast<std::chrono::microseconds>(heap_end-old_end).count()
+			<< " allocs/ms\n";
+
+		for (auto& entry : old_allocated_objs) free(entry.first);
+
+		old_allocated_objs.clear();
+	}
+
+	bool all_found = true;
+
+	for (char* obj : samples)
+	{
+		if (internal_api->heap.FindObject(obj) != obj) all_found = false;
+	}
+
+	TEST(all_allocated, 1);
+	TEST(all_found, 2);
+
+	return 0;
+}
+
+char ulrmeta[] = "pc[]Program:[System]Object,$8;.ctor p();.entr s[System]Int32 Main([System]String[]);\n";
+
+void* ulraddr[] = {
+	(void*) overload0_ns0_Program_ctor,
+	(void*) overload0_ns0_Program_Main
+};
+
+char* ulrdeps[] = { nullptr };
+
+END_ULR_EXPORT
@@ -0,0 +1,128 @@
+﻿#define TEST(condition, num) if (condition) std::cout << "+ Test " << num << " passed!\n"; else std::cout << "- Test " << num << " failed :(\n";
+
+#include <StdULR.hpp>
+#include <iostream>
+#include <sstream>
+#include <chrono>
+
+const size_t SMALL_ALLOCS = 2000000; // 64 MB of 32 byte objects
+const size_t SMALL_SIZE = sizeof(Type*)+24;
+const size_t BIG_ALLOCS = 4000; // 64 MB of 16 KB arrays
+const size_t BIG_SIZE = 16000;
+
+Type* small_type;
+Type* big_type;
+
+BEGIN_ULR_EXPORT
+
+void InitAssembly(ULRAPIImpl* ulr)
+{
+	internal_api = ulr;
+}
+
+void overload0_ns0_Program_ctor(char* self) {}
+
+void overload0_ns0_Small_ctor(char* self) {}
+
+void overload0_ns0_Big_ctor(char* self) {}
+
+double run(bool profiling)
+{
+	if (profiling) internal_api->allocation_profiler.Start(64*1024);
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < SMALL_ALLOCS; i++)
+	{
+		char* obj = internal_api->AllocateObject(SMALL_SIZE);
+
+		*(Type**) obj = small_type;
+	}
+
+	for (size_t i = 0; i < BIG_ALLOCS; i++)
+	{
+		char* obj = internal_api->AllocateObject(BIG_SIZE);
+
+		*(Type**) obj = big_type;
+	}
+
+	auto end = std::chrono::steady_clock::now();
+
+	if (profiling) internal_api->allocation_profiler.Stop();
+
+	return std::chrono::duration_cast<std::chrono::microseconds>(end-start).count()/1000.0;
+}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Main(char* argv)
+{
+	char* framebase;
+
+	asm(
+		"mov %0, rbp\n\t"
+		:"=r"(framebase)
+	);
+
+	framebase-=sizeof(char*); // skip all "framebase" itself;
+
+	internal_api->InitGCLocalVarRoot((char**) framebase);
+
+	small_type = internal_api->GetType("[]Small");
+	big_type = internal_api->GetType("[]Big");
+
+	double disabled_ms = run(false);
+	double enabled_ms = run(true);
+
+	std::cout << "disabled: " << disabled_ms << " ms, sampling every 64 KB: " << enabled_ms << " ms\n";
+
+	auto stats = internal_api->allocation_profiler.GetTypeStats();
+
+	double small_size = 0;
+	double big_size = 0;
+	double small_objects = 0;
+
+	for (auto& type_stats : stats)
+	{
+		std::cout << (type_stats.first ? internal_api->GetDisplayNameOf(type_stats.first) : "[unknown type]") << ": "
+			<< type_stats.second.num_samples << " samples, ~" << (size_t) type_stats.second.num_objects << " objects, ~"
+			<< (size_t) type_stats.second.size << " bytes\n";
+
+		if (type_stats.first == small_type)
+		{
+			small_size = type_stats.second.size;
+			small_objects = type_stats.second.num_objects;
+		}
+		else if (type_stats.first == big_type) big_size = type_stats.second.size;
+	}
+
+	std::stringstream folded;
+
+	internal_api->allocation_profiler.WriteFolded(folded);
+
+	std::cout << folded.str();
+
+	std::stringstream pprof;
+
+	internal_api->allocation_profiler.WritePprof(pprof);
+
+	// the estimates are within a few percent with ~1000 samples per type
+	TEST(small_size > SMALL_ALLOCS*SMALL_SIZE*0.8 && small_size < SMALL_ALLOCS*SMALL_SIZE*1.2, 1);
+	TEST(big_size > BIG_ALLOCS*BIG_SIZE*0.8 && big_size < BIG_ALLOCS*BIG_SIZE*1.2, 2);
+	TEST(small_objects > SMALL_ALLOCS*0.8 && small_objects < SMALL_ALLOCS*1.2, 3);
+	TEST(stats.size() == 2 && folded.str().find("Program.Main") != std::string::npos, 4);
+	TEST(pprof.str().size() > 0 && pprof.str().find("alloc_space") != std::string::npos, 5);
+
+	return 0;
+}
+
+char ulrmeta[] = "pc[]Program:[System]Object,$8;.ctor p();.entr s[System]Int32 Main([System]String[]);\npc[]Small:[System]Object,$32;.ctor p();\npc[]Big:[System]Object,$16000;.ctor p();\n";
+
+void* ulraddr[] = {
+	(void*) overload0_ns0_Program_ctor,
+	(void*) overload0_ns0_Program_Main,
+	(void*) overload0_ns0_Small_ctor,
+	(void*) overload0_ns0_Big_ctor
+};
+
+char* ulrdeps[] = { nullptr };
+
+END_ULR_EXPORT
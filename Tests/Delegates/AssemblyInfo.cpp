@@ -0,0 +1,160 @@
+﻿#define TEST(condition, num) if (condition) std::cout << "+ Test " << num << " passed!\n"; else std::cout << "- Test " << num << " failed :(\n";
+
+#include <StdULR.hpp>
+#include <iostream>
+#include <chrono>
+
+const size_t NUM_CALLS = 1000000;
+
+BEGIN_ULR_EXPORT
+
+void overload0_ns0_Animal_ctor(char*);
+void overload0_ns0_Dog_ctor(char*);
+
+void InitAssembly(ULRAPIImpl* ulr)
+{
+	internal_api = ulr;
+}
+
+void overload0_ns0_Program_ctor(char* self) {}
+
+// the new receiver is only referenced from this frame, so once it returns only the delegate (and the weak handle, which doesn't count) refers to it
+static __attribute__((noinline)) Delegate* BindNewDog(MethodInfo* speak, Type* dog_type, Heap::GCHandle* weak)
+{
+	char* dog = internal_api->ConstructObject(overload0_ns0_Dog_ctor, dog_type);
+
+	*weak = internal_api->NewGCHandle(dog, Heap::GCHandleType::Weak);
+
+	return internal_api->CreateDelegate(speak, dog);
+}
+
+// overwrites the dead frames below the caller, so that stale ptrs in them can't keep objects alive through the conservative stack scan
+static __attribute__((noinline)) void ScrubStack()
+{
+	volatile char scratch[4096];
+
+	for (size_t i = 0; i < sizeof(scratch); i++) scratch[i] = 0;
+}
+
+static __attribute__((noinline)) bool IsAlive(Heap::GCHandle weak)
+{
+	return internal_api->GetGCHandleTarget(weak) != nullptr;
+}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Main(char* argv)
+{
+	char* framebase;
+
+	asm(
+		"mov %0, rbp\n\t"
+		:"=r"(framebase)
+	);
+
+	framebase-=sizeof(char*); // skip all "framebase" itself;
+
+	internal_api->InitGCLocalVarRoot((char**) framebase);
+
+	Type* ProgramType = internal_api->GetType("[]Program");
+	Type* AnimalType = internal_api->GetType("[]Animal");
+	Type* DogType = internal_api->GetType("[]Dog");
+	Type* SystemInt32Type = internal_api->GetType("[System]Int32");
+
+	char* animal = internal_api->ConstructObject(overload0_ns0_Animal_ctor, AnimalType);
+	char* dog = internal_api->ConstructObject(overload0_ns0_Dog_ctor, DogType);
+
+	MethodInfo* speak = internal_api->GetMethod(AnimalType, "Speak", { SystemInt32Type });
+	MethodInfo* add = internal_api->GetMethod(ProgramType, "Add", { SystemInt32Type, SystemInt32Type });
+
+	TEST(speak && add && speak->vtable_slot >= 0, 0);
+
+	Delegate* add_delegate = internal_api->CreateDelegate(add);
+
+	TEST(add_delegate && add_delegate->Invoke<sizeof_ns1_System_Int32>(2, 3) == 5, 1);
+
+	Delegate* dog_speak = internal_api->CreateDelegate(speak, dog); // declared on Animal, bound to the override
+
+	TEST(dog_speak && dog_speak->target != speak->offset && dog_speak->Invoke<sizeof_ns1_System_Int32>(10) == 20, 2);
+
+	Delegate* any_speak = internal_api->CreateOpenDelegate(speak);
+
+	TEST(any_speak->InvokeOpen<sizeof_ns1_System_Int32>(animal, 10) == 11 && any_speak->InvokeOpen<sizeof_ns1_System_Int32>(dog, 10) == 20, 3);
+
+	TEST(!internal_api->CreateDelegate(speak), 4); // instance methods need a receiver
+
+	Heap::GCHandle weak_dog = nullptr;
+	Delegate* new_dog_speak = BindNewDog(speak, DogType, &weak_dog);
+
+	ScrubStack();
+
+	internal_api->Collect();
+
+	TEST(IsAlive(weak_dog) && new_dog_speak->Invoke<sizeof_ns1_System_Int32>(1) == 2, 5); // the delegate keeps its receiver alive
+
+	internal_api->FreeDelegate(new_dog_speak);
+
+	ScrubStack();
+
+	internal_api->Collect();
+
+	TEST(!IsAlive(weak_dog), 6); // and nothing else did
+
+	internal_api->FreeGCHandle(weak_dog);
+
+	sizeof_ns1_System_Int32 checksum = 0;
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < NUM_CALLS; i++) checksum+=dog_speak->Invoke<sizeof_ns1_System_Int32>(1);
+
+	auto end = std::chrono::steady_clock::now();
+
+	std::cout << "Delegate: " << std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count()/NUM_CALLS << " ns/call\n";
+
+	TEST(checksum == 2*NUM_CALLS, 7);
+
+	internal_api->FreeDelegate(add_delegate);
+	internal_api->FreeDelegate(dog_speak);
+	internal_api->FreeDelegate(any_speak);
+
+	return 0;
+}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Add(sizeof_ns1_System_Int32 a, sizeof_ns1_System_Int32 b)
+{
+	return a+b;
+}
+
+void overload0_ns0_Animal_ctor(char* self) {}
+
+sizeof_ns1_System_Int32 overload0_ns0_Animal_Speak(char* self, sizeof_ns1_System_Int32 times)
+{
+	return times+1;
+}
+
+void overload0_ns0_Dog_ctor(char* self)
+{
+	overload0_ns0_Animal_ctor(self);
+}
+
+sizeof_ns1_System_Int32 overload0_ns0_Dog_Speak(char* self, sizeof_ns1_System_Int32 times)
+{
+	return times*2;
+}
+
+char ulrmeta[] = "pc[]Program:[System]Object,$8;.ctor p();.entr s[System]Int32 Main([System]String[]);s[System]Int32 Add([System]Int32,[System]Int32);\n"
+	"pc[]Animal:[System]Object,$8;.ctor p();pv[System]Int32 Speak([System]Int32);\n"
+	"pc[]Dog:[]Animal,$8;.ctor p();pv[System]Int32 Speak([System]Int32);\n";
+
+void* ulraddr[] = {
+	(void*) overload0_ns0_Program_ctor,
+	(void*) overload0_ns0_Program_Main,
+	(void*) overload0_ns0_Program_Add,
+	(void*) overload0_ns0_Animal_ctor,
+	(void*) overload0_ns0_Animal_Speak,
+	(void*) overload0_ns0_Dog_ctor,
+	(void*) overload0_ns0_Dog_Speak
+};
+
+char* ulrdeps[] = { nullptr };
+
+END_ULR_EXPORT
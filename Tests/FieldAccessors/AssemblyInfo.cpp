@@ -0,0 +1,100 @@
+﻿#define TEST(condition, num) if (condition) std::cout << "+ Test " << num << " passed!\n"; else std::cout << "- Test " << num << " failed :(\n";
+
+#include <StdULR.hpp>
+#include <iostream>
+
+const size_t RECORD_SIZE = 24;
+
+sizeof_ns1_System_Int32 total_storage = 0; // Record.Total
+
+BEGIN_ULR_EXPORT
+
+void InitAssembly(ULRAPIImpl* ulr)
+{
+	internal_api = ulr;
+}
+
+void overload0_ns0_Program_ctor(char* self) {}
+
+void overload0_ns0_Record_ctor(char* self) {}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Main(char* argv)
+{
+	char* framebase;
+
+	asm(
+		"mov %0, rbp\n\t"
+		:"=r"(framebase)
+	);
+
+	framebase-=sizeof(char*); // skip all "framebase" itself;
+
+	internal_api->InitGCLocalVarRoot((char**) framebase);
+
+	Type* record_type = internal_api->GetType("[]Record");
+	Type* SystemInt32Type = internal_api->GetType("[System]Int32");
+
+	FieldInfo* count = internal_api->GetField(record_type, "Count", BindingFlags::Public | BindingFlags::Instance);
+	FieldInfo* next = internal_api->GetField(record_type, "Next", BindingFlags::Public | BindingFlags::Instance);
+	FieldInfo* total = internal_api->GetField(record_type, "Total", BindingFlags::Public | BindingFlags::Static);
+
+	TEST(count && next && total, 0);
+	TEST(count->kind == FieldKind::Value && count->data_size == sizeof(sizeof_ns1_System_Int32) && count->data_offset == 16, 1);
+	TEST(next->kind == FieldKind::Ref && next->data_offset == 8 && next->has_refs, 2);
+
+	char* first = internal_api->AllocateZeroed(RECORD_SIZE);
+	char* second = internal_api->AllocateZeroed(RECORD_SIZE);
+
+	*(Type**) first = record_type;
+	*(Type**) second = record_type;
+
+	count->Write<sizeof_ns1_System_Int32>(first, 5);
+	next->Write<char*>(first, second);
+	total->Write<sizeof_ns1_System_Int32>(nullptr, 12);
+
+	TEST(*(sizeof_ns1_System_Int32*) (first+16) == 5 && *(char**) (first+8) == second && total_storage == 12, 3);
+	TEST(count->Read<sizeof_ns1_System_Int32>(first) == 5 && next->Read<char*>(first) == second, 4);
+
+	sizeof_ns1_System_Int32 copied = 0;
+	sizeof_ns1_System_Int32 value = 9;
+
+	count->CopyFrom(second, &value);
+	count->CopyTo(second, &copied);
+
+	TEST(copied == 9, 5);
+
+	// the boxed API goes through the same accessors
+	char* boxed = count->GetValue(first);
+
+	TEST(*(Type**) boxed == SystemInt32Type && internal_api->UnBox<sizeof_ns1_System_Int32>(boxed) == 5, 6);
+
+	sizeof_ns1_System_Int32 seven = 7;
+
+	count->SetValue(first, internal_api->Box<sizeof_ns1_System_Int32>(seven, SystemInt32Type));
+
+	TEST(count->Read<sizeof_ns1_System_Int32>(first) == 7 && next->GetValue(first) == second, 7);
+
+	size_t size_before = internal_api->heap.allocated_size;
+	sizeof_ns1_System_Int32 sum = 0;
+
+	for (char* record = first; record; record = next->Read<char*>(record)) sum+=count->Read<sizeof_ns1_System_Int32>(record);
+
+	TEST(sum == 7+9 && internal_api->heap.allocated_size == size_before, 8);
+
+	return 0;
+}
+
+char ulrmeta[] = "pc[]Program:[System]Object,$8;.ctor p();.entr s[System]Int32 Main([System]String[]);\npc[]Record:[System]Object,$24;.ctor p();.fldv p[]Record Next;.fldv p[System]Int32 Count;.fldv ps[System]Int32 Total;\n";
+
+void* ulraddr[] = {
+	(void*) overload0_ns0_Program_ctor,
+	(void*) overload0_ns0_Program_Main,
+	(void*) overload0_ns0_Record_ctor,
+	(void*) 8,
+	(void*) 16,
+	(void*) &total_storage
+};
+
+char* ulrdeps[] = { nullptr };
+
+END_ULR_EXPORT
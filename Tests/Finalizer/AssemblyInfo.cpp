@@ -0,0 +1,96 @@
+﻿#define TEST(condition, num) if (condition) std::cout << "+ Test " << num << " passed!\n"; else std::cout << "- Test " << num << " failed :(\n";
+
+#include <StdULR.hpp>
+#include <iostream>
+#include <atomic>
+
+const size_t NUM_RESOURCES = 1000;
+
+std::atomic<size_t> num_dtors_run { 0 };
+
+BEGIN_ULR_EXPORT
+
+void InitAssembly(ULRAPIImpl* ulr)
+{
+	internal_api = ulr;
+}
+
+void overload0_ns0_Program_ctor(char* self) {}
+
+void overload0_ns0_Resource_ctor(char* self) {}
+
+void overload0_ns0_Resource_dtor(char* self)
+{
+	num_dtors_run++;
+}
+
+void overload0_ns0_SubResource_ctor(char* self) {}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Main(char* argv)
+{
+	char* framebase;
+
+	asm(
+		"mov %0, rbp\n\t"
+		:"=r"(framebase)
+	);
+
+	framebase-=sizeof(char*); // skip all "framebase" itself;
+
+	internal_api->InitGCLocalVarRoot((char**) framebase);
+
+	Type* resource_type = internal_api->GetType("[]Resource");
+	Type* sub_resource_type = internal_api->GetType("[]SubResource");
+
+	for (size_t i = 0; i < NUM_RESOURCES; i++) internal_api->ConstructObject(overload0_ns0_Resource_ctor, resource_type);
+
+	// allocated without ConstructObject, and only the base declares a dtor
+	for (size_t i = 0; i < NUM_RESOURCES; i++)
+	{
+		char* obj = internal_api->AllocateObject(sub_resource_type->size);
+
+		*(Type**) obj = sub_resource_type;
+
+		overload0_ns0_SubResource_ctor(obj);
+	}
+
+	char* framelimit;
+
+	asm(
+		"mov %0, rsp\n\t"
+		:"=r"(framelimit)
+	);
+
+	internal_api->InitGCLocalVarEnd((char**) framelimit); // only scan Main's frame for roots
+
+	// a stale ref to the last resource may still be on the stack
+	GCResult first = internal_api->Collect();
+
+	TEST(first.num_finalizable >= (2*NUM_RESOURCES)-1, 1);
+
+	internal_api->WaitForPendingFinalizers();
+
+	TEST(internal_api->finalizer_queue_length == 0, 2);
+	TEST(num_dtors_run == first.num_finalizable && internal_api->num_finalized == num_dtors_run, 3);
+
+	GCResult second = internal_api->Collect(); // queued objects survived the first collection until their dtor had run
+
+	TEST(second.num_collected >= first.num_finalizable && second.num_finalizable == 0, 4);
+	TEST(num_dtors_run == first.num_finalizable, 5); // finalized objects are freed without running their dtor again
+
+	return 0;
+}
+
+char ulrmeta[] = "pc[]Program:[System]Object,$8;.ctor p();.entr s[System]Int32 Main([System]String[]);\npc[]Resource:[System]Object,$16;.ctor p();.dtor;\npc[]SubResource:[]Resource,$16;.ctor p();\n";
+
+void* ulraddr[] = {
+	(void*) overload0_ns0_Program_ctor,
+	(void*) overload0_ns0_Program_Main,
+	(void*) overload0_ns0_Resource_ctor,
+	(void*) overload0_ns0_Resource_dtor,
+	(void*) overload0_ns0_SubResource_ctor
+};
+
+char* ulrdeps[] = { nullptr };
+
+END_ULR_EXPORT
@@ -35,12 +35,21 @@ sizeof_ns1_System_Int32 overload0_ns0_Program_Main(char* argv)
 
 	// the object should still be accessible at the end
 
-	GCResult gcres = internal_api->last_gc_result;
+	char* framelimit;
+
+	asm(
+		"mov %0, rsp\n\t"
+		:"=r"(framelimit)
+	);
+
+	internal_api->InitGCLocalVarEnd((char**) framelimit); // only scan Main's frame for roots
+
+	internal_api->Collect();
 	
-	// only 198 objects would be collected because the GC would trigger just before the 200th allocation (1990mb+10mb >= GC_TRIGGER_SIZE) -> 
-	//this means that the 199th object would still be accessible and not collected; the 200th object would not have been created yet
-	TEST(gcres.num_collected == 198, 1); 
-	TEST(gcres.size_collected == 10000000*198, 2);
+	// nursery collections (every 32 MB of allocations) already collected most of the objects, the full collection gets the rest ->
+	// only the last object is still accessible, the rest of the heap is much smaller than 10 MB
+	TEST(internal_api->heap.allocated_size < 10000000*2, 1); 
+	TEST(internal_api->heap.FindObject(obj) == obj, 2);
 
 	*obj = 'a';
 
@@ -0,0 +1,141 @@
+﻿#define TEST(condition, num) if (condition) std::cout << "+ Test " << num << " passed!\n"; else std::cout << "- Test " << num << " failed :(\n";
+
+#include <StdULR.hpp>
+#include <iostream>
+#include <vector>
+
+const size_t NUM_CACHED = 1000;
+const size_t NODE_SIZE = sizeof(Type*)+24;
+
+Type* node_type;
+
+// native containers aren't scanned, only the handles keep (or track) their objects
+std::vector<Heap::GCHandle>* strong_cache;
+std::vector<Heap::GCHandle>* weak_cache;
+
+BEGIN_ULR_EXPORT
+
+void InitAssembly(ULRAPIImpl* ulr)
+{
+	internal_api = ulr;
+}
+
+void overload0_ns0_Program_ctor(char* self) {}
+
+void overload0_ns0_Node_ctor(char* self) {}
+
+char* NewNode(char* next)
+{
+	char* node = internal_api->AllocateZeroed(NODE_SIZE);
+
+	*(Type**) node = node_type;
+	*(char**) (node+8) = next;
+
+	ULR_WRITE_BARRIER(node);
+
+	return node;
+}
+
+// the nodes are created in a separate frame, so no copies are left in Main's stack range
+__attribute__((noinline)) void FillCaches()
+{
+	for (size_t i = 0; i < NUM_CACHED; i++)
+	{
+		strong_cache->push_back(internal_api->NewGCHandle(NewNode(NewNode(nullptr)), Heap::GCHandleType::Strong));
+		weak_cache->push_back(internal_api->NewGCHandle(NewNode(nullptr), Heap::GCHandleType::Weak));
+	}
+}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Main(char* argv)
+{
+	char* framebase;
+
+	asm(
+		"mov %0, rbp\n\t"
+		:"=r"(framebase)
+	);
+
+	framebase-=sizeof(char*); // skip all "framebase" itself;
+
+	internal_api->InitGCLocalVarRoot((char**) framebase);
+
+	node_type = internal_api->GetType("[]Node");
+
+	strong_cache = new std::vector<Heap::GCHandle>();
+	weak_cache = new std::vector<Heap::GCHandle>();
+
+	FillCaches();
+
+	// a weak handle to an object that is also strongly held stays set
+	Heap::GCHandle shared = internal_api->NewGCHandle(internal_api->GetGCHandleTarget((*strong_cache)[0]), Heap::GCHandleType::Weak);
+
+	internal_api->Collect();
+
+	Heap::GCEvent event;
+
+	internal_api->gc_telemetry.GetRecentEvents(&event, 1);
+
+	bool strong_alive = true;
+
+	for (Heap::GCHandle handle : *strong_cache)
+	{
+		char* node = internal_api->GetGCHandleTarget(handle);
+
+		strong_alive = strong_alive && internal_api->heap.FindObject(node) && internal_api->heap.FindObject(*(char**) (node+8)); // what the target references survives too
+	}
+
+	size_t weak_cleared = 0;
+
+	for (Heap::GCHandle handle : *weak_cache)
+	{
+		if (!internal_api->GetGCHandleTarget(handle)) weak_cleared++;
+	}
+
+	TEST(strong_alive, 1);
+	TEST(weak_cleared >= NUM_CACHED-16, 2); // a few may still be found conservatively in dead stack slots or registers
+	TEST(internal_api->GetGCHandleTarget(shared) == internal_api->GetGCHandleTarget((*strong_cache)[0]), 3);
+	TEST(event.num_handles == 2*NUM_CACHED+1 && event.num_weak_handles_cleared == weak_cleared, 4);
+
+	// freeing the strong handles releases their objects
+	size_t size_before = internal_api->heap.allocated_size;
+
+	for (Heap::GCHandle handle : *strong_cache) internal_api->FreeGCHandle(handle);
+
+	internal_api->Collect();
+
+	TEST(size_before-internal_api->heap.allocated_size >= (NUM_CACHED-16)*2*NODE_SIZE, 5);
+	TEST(!internal_api->GetGCHandleTarget(shared), 6);
+
+	// pinned arrays keep their address, so native code can hold a ptr to the elements
+	char* array = internal_api->AllocateArray(internal_api->GetArrayTypePrimarily("[System]Int32[]"), 256);
+	int* elems = (int*) (array+sizeof(Type*)+sizeof(int));
+
+	Heap::GCHandle pinned = internal_api->NewGCHandle(array, Heap::GCHandleType::Pinned);
+
+	array = nullptr;
+	elems[255] = 42;
+
+	internal_api->Collect();
+
+	TEST(internal_api->heap.FindContainingObject((char*) &elems[255]) == internal_api->GetGCHandleTarget(pinned) && elems[255] == 42, 7);
+
+	internal_api->FreeGCHandle(pinned);
+	internal_api->FreeGCHandle(shared);
+
+	for (Heap::GCHandle handle : *weak_cache) internal_api->FreeGCHandle(handle);
+
+	return 0;
+}
+
+char ulrmeta[] = "pc[]Program:[System]Object,$8;.ctor p();.entr s[System]Int32 Main([System]String[]);\npc[]Node:[System]Object,$32;.ctor p();.fldv p[]Node Next;\n";
+
+void* ulraddr[] = {
+	(void*) overload0_ns0_Program_ctor,
+	(void*) overload0_ns0_Program_Main,
+	(void*) overload0_ns0_Node_ctor,
+	(void*) 8
+};
+
+char* ulrdeps[] = { nullptr };
+
+END_ULR_EXPORT
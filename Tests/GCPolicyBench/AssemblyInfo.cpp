@@ -0,0 +1,140 @@
+﻿#define TEST(condition, num) if (condition) std::cout << "+ Test " << num << " passed!\n"; else std::cout << "- Test " << num << " failed :(\n";
+
+#include <StdULR.hpp>
+#include <iostream>
+#include <chrono>
+
+const size_t LIVE_NODES = 500000; // 16 MB live set
+const size_t GARBAGE_ALLOCS = 20000000; // 640 MB of garbage
+const size_t NODE_SIZE = sizeof(Type*)+24;
+
+Type* node_type;
+
+struct PolicyRun
+{
+	const char* name;
+	Heap::GCConfig config;
+};
+
+BEGIN_ULR_EXPORT
+
+void InitAssembly(ULRAPIImpl* ulr)
+{
+	internal_api = ulr;
+}
+
+void overload0_ns0_Program_ctor(char* self) {}
+
+void overload0_ns0_Node_ctor(char* self) {}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Main(char* argv)
+{
+	char* framebase;
+
+	asm(
+		"mov %0, rbp\n\t"
+		:"=r"(framebase)
+	);
+
+	framebase-=sizeof(char*); // skip all "framebase" itself;
+
+	internal_api->InitGCLocalVarRoot((char**) framebase);
+
+	node_type = internal_api->GetType("[]Node");
+
+	char* volatile head = nullptr; // the live set, a list kept alive from the stack
+
+	for (size_t i = 0; i < LIVE_NODES; i++)
+	{
+		char* node = internal_api->AllocateZeroed(NODE_SIZE);
+
+		*(Type**) node = node_type;
+		*(char**) (node+8) = head;
+
+		ULR_WRITE_BARRIER(node);
+
+		head = node;
+	}
+
+	Heap::GCConfig throughput;
+
+	throughput.nursery_size = 32000000; // opt in, every reference store above has its barrier
+
+	Heap::GCConfig compact = throughput;
+	Heap::GCConfig latency = throughput;
+	Heap::GCConfig limited = throughput;
+
+	compact.growth_factor = 1.25;
+	compact.min_heap_size = 0;
+
+	latency.mode = Heap::GCMode::Latency;
+	latency.min_heap_size = 0;
+
+	limited.heap_limit = 48000000;
+	limited.min_heap_size = 0;
+
+	PolicyRun runs[] = {
+		{ "throughput (growth 2)", throughput },
+		{ "throughput (growth 1.25)", compact },
+		{ "latency", latency },
+		{ "throughput, 48 MB limit", limited }
+	};
+
+	bool all_allocated = true;
+
+	for (auto& run : runs)
+	{
+		internal_api->SetGCPolicy(Heap::CreateGCPolicy(run.config));
+		internal_api->Collect();
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (size_t i = 0; i < GARBAGE_ALLOCS; i++)
+		{
+			char* garbage = internal_api->AllocateObject(NODE_SIZE);
+
+			if (!garbage)
+			{
+				all_allocated = false;
+				continue;
+			}
+
+			*(Type**) garbage = node_type;
+			*(char**) (garbage+8) = nullptr;
+		}
+
+		auto end = std::chrono::steady_clock::now();
+
+		Heap::GCPolicy* policy = internal_api->gc_policy;
+
+		std::cout
+			<< run.name << ": "
+			<< std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count() << " ms, peak heap "
+			<< policy->peak_heap_size/1000000 << " MB, "
+			<< policy->num_full << " full + " << policy->num_nursery << " nursery collections, max pause "
+			<< policy->max_pause_us << " us\n";
+	}
+
+	size_t list_len = 0;
+
+	for (char* node = head; node; node = *(char**) (node+8)) list_len++;
+
+	TEST(all_allocated, 1);
+	TEST(list_len == LIVE_NODES, 2);
+	TEST(internal_api->gc_policy->peak_heap_size <= 48000000, 3);
+
+	return 0;
+}
+
+char ulrmeta[] = "pc[]Program:[System]Object,$8;.ctor p();.entr s[System]Int32 Main([System]String[]);\npc[]Node:[System]Object,$32;.ctor p();.fldv p[]Node Next;\n";
+
+void* ulraddr[] = {
+	(void*) overload0_ns0_Program_ctor,
+	(void*) overload0_ns0_Program_Main,
+	(void*) overload0_ns0_Node_ctor,
+	(void*) 8
+};
+
+char* ulrdeps[] = { nullptr };
+
+END_ULR_EXPORT
@@ -0,0 +1,129 @@
+﻿#define TEST(condition, num) if (condition) std::cout << "+ Test " << num << " passed!\n"; else std::cout << "- Test " << num << " failed :(\n";
+
+#include <StdULR.hpp>
+#include <iostream>
+
+const size_t LIVE_NODES = 10000;
+const size_t GARBAGE_ALLOCS = 100000;
+const size_t NODE_SIZE = sizeof(Type*)+24;
+const size_t NUM_ROUNDS = 300; // more than the ring buffer holds
+
+Type* node_type;
+
+BEGIN_ULR_EXPORT
+
+void InitAssembly(ULRAPIImpl* ulr)
+{
+	internal_api = ulr;
+}
+
+void overload0_ns0_Program_ctor(char* self) {}
+
+void overload0_ns0_Node_ctor(char* self) {}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Main(char* argv)
+{
+	char* framebase;
+
+	asm(
+		"mov %0, rbp\n\t"
+		:"=r"(framebase)
+	);
+
+	framebase-=sizeof(char*); // skip all "framebase" itself;
+
+	internal_api->InitGCLocalVarRoot((char**) framebase);
+
+	node_type = internal_api->GetType("[]Node");
+
+	char* volatile head = nullptr;
+
+	for (size_t i = 0; i < LIVE_NODES; i++)
+	{
+		char* node = internal_api->AllocateZeroed(NODE_SIZE);
+
+		*(Type**) node = node_type;
+		*(char**) (node+8) = head;
+
+		ULR_WRITE_BARRIER(node);
+
+		head = node;
+	}
+
+	Heap::GCTelemetry& telemetry = internal_api->gc_telemetry;
+
+	uint64_t first_id = telemetry.LastEventId()+1;
+	uint64_t nursery_before = telemetry.nursery_pauses.Count();
+	uint64_t full_before = telemetry.full_pauses.Count();
+
+	for (size_t round = 0; round < NUM_ROUNDS; round++)
+	{
+		for (size_t i = 0; i < GARBAGE_ALLOCS/NUM_ROUNDS; i++)
+		{
+			char* garbage = internal_api->AllocateObject(NODE_SIZE);
+
+			*(Type**) garbage = node_type;
+			*(char**) (garbage+8) = nullptr;
+		}
+
+		if (round % 2) internal_api->Collect();
+		else internal_api->CollectNursery();
+	}
+
+	uint64_t last_id = telemetry.LastEventId();
+
+	std::vector<Heap::GCEvent> events(Heap::GC_EVENT_CAPACITY);
+
+	events.resize(telemetry.GetRecentEvents(events.data(), events.size()));
+
+	bool ordered = true;
+	bool consistent = true;
+
+	for (size_t i = 0; i < events.size(); i++)
+	{
+		Heap::GCEvent& event = events[i];
+
+		if (i && event.id != events[i-1].id+1) ordered = false;
+
+		if (event.end_ns < event.start_ns || event.stop_us+event.mark_us+event.finalize_us+event.sweep_us > event.pause_us+4) consistent = false;
+		if (event.heap_size_after > event.heap_size_before || !event.stack_slots_scanned) consistent = false;
+	}
+
+	Heap::GCEvent& last = events.back();
+
+	std::cout
+		<< "last collection: " << (last.nursery ? "nursery" : "full") << ", " << last.pause_us << " us (stop " << last.stop_us
+		<< ", mark " << last.mark_us << ", finalize " << last.finalize_us << ", sweep " << last.sweep_us << "), "
+		<< last.heap_size_before << " -> " << last.heap_size_after << " bytes, " << last.stack_slots_scanned << " stack slots\n"
+		<< "nursery pauses: p50 " << telemetry.nursery_pauses.Percentile(0.5) << " us, p99 " << telemetry.nursery_pauses.Percentile(0.99)
+		<< " us, max " << telemetry.nursery_pauses.Max() << " us\n"
+		<< "full pauses: p50 " << telemetry.full_pauses.Percentile(0.5) << " us, p99 " << telemetry.full_pauses.Percentile(0.99)
+		<< " us, max " << telemetry.full_pauses.Max() << " us\n";
+
+	TEST(last_id-first_id+1 >= NUM_ROUNDS, 1); // allocation may trigger more
+	TEST(events.size() == Heap::GC_EVENT_CAPACITY && last.id == last_id && ordered, 2);
+	TEST(consistent, 3);
+	TEST(telemetry.nursery_pauses.Count()-nursery_before >= NUM_ROUNDS/2 && telemetry.full_pauses.Count()-full_before >= NUM_ROUNDS/2, 4);
+	TEST(telemetry.full_pauses.Percentile(0.5) <= telemetry.full_pauses.Percentile(0.99) && telemetry.full_pauses.Percentile(1) == telemetry.full_pauses.Max(), 5);
+
+	size_t list_len = 0;
+
+	for (char* node = head; node; node = *(char**) (node+8)) list_len++;
+
+	TEST(list_len == LIVE_NODES, 6);
+
+	return 0;
+}
+
+char ulrmeta[] = "pc[]Program:[System]Object,$8;.ctor p();.entr s[System]Int32 Main([System]String[]);\npc[]Node:[System]Object,$32;.ctor p();.fldv p[]Node Next;\n";
+
+void* ulraddr[] = {
+	(void*) overload0_ns0_Program_ctor,
+	(void*) overload0_ns0_Program_Main,
+	(void*) overload0_ns0_Node_ctor,
+	(void*) 8
+};
+
+char* ulrdeps[] = { nullptr };
+
+END_ULR_EXPORT
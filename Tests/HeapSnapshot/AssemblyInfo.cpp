@@ -0,0 +1,105 @@
+﻿#define TEST(condition, num) if (condition) std::cout << "+ Test " << num << " passed!\n"; else std::cout << "- Test " << num << " failed :(\n";
+
+#include <StdULR.hpp>
+#include <iostream>
+#include <chrono>
+
+const size_t LIVE_NODES = 100000;
+const size_t GARBAGE_NODES = 100000;
+const size_t NODE_SIZE = sizeof(Type*)+24;
+
+Type* node_type;
+
+BEGIN_ULR_EXPORT
+
+void InitAssembly(ULRAPIImpl* ulr)
+{
+	internal_api = ulr;
+}
+
+void overload0_ns0_Program_ctor(char* self) {}
+
+void overload0_ns0_Node_ctor(char* self) {}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Main(char* argv)
+{
+	char* framebase;
+
+	asm(
+		"mov %0, rbp\n\t"
+		:"=r"(framebase)
+	);
+
+	framebase-=sizeof(char*); // skip all "framebase" itself;
+
+	internal_api->InitGCLocalVarRoot((char**) framebase);
+
+	node_type = internal_api->GetType("[]Node");
+
+	char* volatile head = nullptr;
+
+	for (size_t i = 0; i < LIVE_NODES+GARBAGE_NODES; i++)
+	{
+		char* node = internal_api->AllocateZeroed(NODE_SIZE);
+
+		*(Type**) node = node_type;
+
+		if (i >= GARBAGE_NODES) // the first ones are dropped
+		{
+			*(char**) (node+8) = head;
+
+			ULR_WRITE_BARRIER(node);
+
+			head = node;
+		}
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	bool written = internal_api->WriteHeapSnapshot("heap.ulrsnap");
+
+	auto end = std::chrono::steady_clock::now();
+
+	std::cout << "snapshot written in " << std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count() << " ms\n";
+
+	Heap::SnapshotReader reader;
+	Heap::SnapshotRecord record;
+
+	bool opened = reader.Open("heap.ulrsnap");
+
+	uint64_t node_type_id = 0;
+	size_t num_nodes = 0;
+	size_t num_node_refs = 0;
+	bool head_is_root = false;
+
+	while (opened && reader.Next(record))
+	{
+		if (record.tag == Heap::SnapshotType && record.name == internal_api->GetDisplayNameOf(node_type)) node_type_id = record.type_id;
+		else if (record.tag == Heap::SnapshotObject && record.type_id == node_type_id)
+		{
+			num_nodes++;
+			num_node_refs+=record.refs.size();
+		}
+		else if (record.tag == Heap::SnapshotRoot && record.address == (uint64_t) head) head_is_root = record.root_kind == Heap::RootKind::Stack;
+	}
+
+	TEST(written && opened && !reader.Malformed(), 1);
+	TEST(num_nodes == LIVE_NODES, 2); // the garbage was collected before the snapshot
+	TEST(num_node_refs == LIVE_NODES-1, 3);
+	TEST(head_is_root, 4);
+
+	return 0;
+}
+
+char ulrmeta[] = "pc[]Program:[System]Object,$8;.ctor p();.entr s[System]Int32 Main([System]String[]);\npc[]Node:[System]Object,$32;.ctor p();.fldv p[]Node Next;\n";
+
+void* ulraddr[] = {
+	(void*) overload0_ns0_Program_ctor,
+	(void*) overload0_ns0_Program_Main,
+	(void*) overload0_ns0_Node_ctor,
+	(void*) 8
+};
+
+char* ulrdeps[] = { nullptr };
+
+END_ULR_EXPORT
@@ -0,0 +1,202 @@
+﻿#define TEST(condition, num) if (condition) std::cout << "+ Test " << num << " passed!\n"; else std::cout << "- Test " << num << " failed :(\n";
+
+#include <StdULR.hpp>
+#include <iostream>
+
+struct Vec
+{
+	sizeof_ns1_System_Int64 x;
+	sizeof_ns1_System_Int64 y;
+};
+
+struct Mixed
+{
+	double d;
+	sizeof_ns1_System_Int64 l;
+};
+
+BEGIN_ULR_EXPORT
+
+__attribute__((sysv_abi)) Mixed ScaleMixedSysV(Mixed m, double by);
+
+void InitAssembly(ULRAPIImpl* ulr)
+{
+	internal_api = ulr;
+}
+
+void overload0_ns0_Program_ctor(char* self) {}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Main(char* argv)
+{
+	char* framebase;
+
+	asm(
+		"mov %0, rbp\n\t"
+		:"=r"(framebase)
+	);
+
+	framebase-=sizeof(char*); // skip all "framebase" itself;
+
+	internal_api->InitGCLocalVarRoot((char**) framebase);
+
+	Type* ProgramType = internal_api->GetType("[]Program");
+	Type* VecType = internal_api->GetType("[]Vec");
+	Type* SystemInt32Type = internal_api->GetType("[System]Int32");
+	Type* SystemInt64Type = internal_api->GetType("[System]Int64");
+	Type* SystemFloatType = internal_api->GetType("[System]Float");
+	Type* SystemDoubleType = internal_api->GetType("[System]Double");
+
+	TEST(IsFloatingPointType(SystemFloatType) && IsFloatingPointType(SystemDoubleType) && !IsFloatingPointType(SystemInt64Type), 0);
+
+	MethodInfo* scale = internal_api->GetMethod(ProgramType, "Scale", { SystemFloatType, SystemDoubleType });
+	MethodInfo* mix = internal_api->GetMethod(ProgramType, "Mix", { SystemInt32Type, SystemDoubleType, SystemFloatType, SystemInt64Type, SystemDoubleType, SystemFloatType });
+	MethodInfo* make_vec = internal_api->GetMethod(ProgramType, "MakeVec", { SystemInt64Type, SystemInt64Type });
+	MethodInfo* sum = internal_api->GetMethod(VecType, "Sum", { SystemInt64Type });
+
+	TEST(scale && mix && make_vec && sum, 1);
+
+	// float and double args and returns go through the vector registers
+	float f = 1.5f;
+	double d = 4.0;
+
+	char* boxed_scaled = scale->Invoke(nullptr, { internal_api->Box(f, SystemFloatType), internal_api->Box(d, SystemDoubleType) });
+
+	TEST(internal_api->UnBox<float>(boxed_scaled) == 6.0f, 2);
+
+	float scaled = 0;
+	void* scale_args[] = { &f, &d };
+
+	scale->InvokeUnboxed(nullptr, scale_args, &scaled);
+
+	TEST(scaled == 6.0f, 3);
+
+	// the last two are passed on the stack under Win64, and interleaved with integer args under System V
+	sizeof_ns1_System_Int32 i = 2;
+	double d0 = 0.25;
+	float f0 = 1.5f;
+	sizeof_ns1_System_Int64 l = 3;
+	double d1 = 10.5;
+	float f1 = 0.5f;
+
+	char* boxed_mixed = mix->Invoke(
+		nullptr,
+		{
+			internal_api->Box(i, SystemInt32Type),
+			internal_api->Box(d0, SystemDoubleType),
+			internal_api->Box(f0, SystemFloatType),
+			internal_api->Box(l, SystemInt64Type),
+			internal_api->Box(d1, SystemDoubleType),
+			internal_api->Box(f1, SystemFloatType)
+		}
+	);
+
+	TEST(internal_api->UnBox<double>(boxed_mixed) == 17.75, 4);
+
+	double mixed = 0;
+	void* mix_args[] = { &i, &d0, &f0, &l, &d1, &f1 };
+
+	mix->InvokeUnboxed(nullptr, mix_args, &mixed);
+
+	TEST(mixed == 17.75, 5);
+
+	// a 16 byte struct is returned through hidden storage under Win64 (and in rax:rdx under System V)
+	sizeof_ns1_System_Int64 x = 7;
+	sizeof_ns1_System_Int64 y = -3;
+
+	char* boxed_vec = make_vec->Invoke(nullptr, { internal_api->Box(x, SystemInt64Type), internal_api->Box(y, SystemInt64Type) });
+
+	Vec vec = internal_api->UnBox<Vec>(boxed_vec);
+
+	TEST(vec.x == 7 && vec.y == -3, 6);
+
+	Vec unboxed_vec = { 0, 0 };
+	void* make_vec_args[] = { &x, &y };
+
+	make_vec->InvokeUnboxed(nullptr, make_vec_args, &unboxed_vec);
+
+	TEST(unboxed_vec.x == 7 && unboxed_vec.y == -3, 7);
+
+	// a struct 'this' is passed as a ptr to its data, past the type ptr of the box
+	sizeof_ns1_System_Int64 extra = 100;
+
+	char* boxed_sum = sum->Invoke(boxed_vec, { internal_api->Box(extra, SystemInt64Type) });
+
+	TEST(internal_api->UnBox<sizeof_ns1_System_Int64>(boxed_sum) == 104, 8);
+
+	sizeof_ns1_System_Int64 summed = 0;
+	void* sum_args[] = { &extra };
+
+	sum->InvokeUnboxed((char*) &unboxed_vec, sum_args, &summed); // unboxed calls take self as is
+
+	TEST(summed == 104, 9);
+
+	// System V classifies each eightbyte of a small struct by its fields, [System]Double d goes in a vector register and l in an integer one
+	Type* MixedType = internal_api->GetType("[]Mixed");
+
+	InvokeStubCache sysv_stubs(CallingConvention::SysV);
+	InvokeShape sysv_shape = sysv_stubs.ShapeOf(nullptr, { MixedType, SystemDoubleType }, MixedType, true);
+
+	TEST(sysv_shape.sse_words[0] == 1 && sysv_shape.ret == InvokeReturnKind::Pair && sysv_shape.ret_sse_words == 1, 10);
+
+	Mixed mixed_arg = { 1.5, 20 };
+	double scale_by = 2.0;
+	Mixed sysv_ret = { 0, 0 };
+	void* sysv_args[] = { &mixed_arg, &scale_by };
+
+	InvokeStub sysv_stub = sysv_stubs.GetStub(sysv_shape);
+
+	if (sysv_stub) sysv_stub((void*) ScaleMixedSysV, nullptr, sysv_args, &sysv_ret);
+
+	TEST(sysv_ret.d == 3.0 && sysv_ret.l == 40, 11);
+
+	return 0;
+}
+
+// called through the System V stub above, whatever the native convention is
+__attribute__((sysv_abi)) Mixed ScaleMixedSysV(Mixed m, double by)
+{
+	return { m.d*by, (sizeof_ns1_System_Int64) (m.l*by) };
+}
+
+float overload0_ns0_Program_Scale(float a, double b)
+{
+	return (float) (a*b);
+}
+
+double overload0_ns0_Program_Mix(sizeof_ns1_System_Int32 i, double d0, float f0, sizeof_ns1_System_Int64 l, double d1, float f1)
+{
+	return i+d0+f0+l+d1+f1;
+}
+
+Vec overload0_ns0_Program_MakeVec(sizeof_ns1_System_Int64 x, sizeof_ns1_System_Int64 y)
+{
+	return { x, y };
+}
+
+void overload0_ns0_Vec_ctor(Vec* self) {}
+
+void overload0_ns0_Mixed_ctor(Mixed* self) {}
+
+sizeof_ns1_System_Int64 overload0_ns0_Vec_Sum(Vec* self, sizeof_ns1_System_Int64 extra)
+{
+	return self->x+self->y+extra;
+}
+
+char ulrmeta[] = "pc[]Program:[System]Object,$8;.ctor p();.entr s[System]Int32 Main([System]String[]);s[System]Float Scale([System]Float,[System]Double);s[System]Double Mix([System]Int32,[System]Double,[System]Float,[System]Int64,[System]Double,[System]Float);s[]Vec MakeVec([System]Int64,[System]Int64);\npv[]Vec:[System]Object,$16;.ctor p();p[System]Int64 Sum([System]Int64);\npv[]Mixed:[System]Object,$16;.ctor p();.fldv p[System]Double D;.fldv p[System]Int64 L;\n";
+
+void* ulraddr[] = {
+	(void*) overload0_ns0_Program_ctor,
+	(void*) overload0_ns0_Program_Main,
+	(void*) overload0_ns0_Program_Scale,
+	(void*) overload0_ns0_Program_Mix,
+	(void*) overload0_ns0_Program_MakeVec,
+	(void*) overload0_ns0_Vec_ctor,
+	(void*) overload0_ns0_Vec_Sum,
+	(void*) overload0_ns0_Mixed_ctor,
+	(void*) 0,
+	(void*) 8
+};
+
+char* ulrdeps[] = { nullptr };
+
+END_ULR_EXPORT
@@ -0,0 +1,83 @@
+﻿#define TEST(condition, num) if (condition) std::cout << "+ Test " << num << " passed!\n"; else std::cout << "- Test " << num << " failed :(\n";
+
+#include <StdULR.hpp>
+#include <iostream>
+#include <chrono>
+#include <climits>
+
+const size_t BIG_LENGTH = 1000000; // 8 MB of longs
+const size_t NUM_BIG_ARRAYS = 200;
+const size_t MEDIUM_SIZE = 20000; // between the old 8 KB small object limit and the large object space
+
+BEGIN_ULR_EXPORT
+
+void InitAssembly(ULRAPIImpl* ulr)
+{
+	internal_api = ulr;
+}
+
+void overload0_ns0_Program_ctor(char* self) {}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Main(char* argv)
+{
+	char* framebase;
+
+	asm(
+		"mov %0, rbp\n\t"
+		:"=r"(framebase)
+	);
+
+	framebase-=sizeof(char*); // skip all "framebase" itself;
+
+	internal_api->InitGCLocalVarRoot((char**) framebase);
+
+	Type* long_array_type = internal_api->GetArrayTypePrimarily("[System]Int64[]");
+
+	char* volatile kept = internal_api->AllocateArray(long_array_type, BIG_LENGTH);
+
+	bool zeroed = true;
+	bool aligned = true;
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < NUM_BIG_ARRAYS; i++)
+	{
+		char* arr = internal_api->AllocateArray(long_array_type, BIG_LENGTH);
+
+		long long* elems = (long long*) (arr+sizeof(Type*)+sizeof(int));
+
+		zeroed = zeroed && elems[0] == 0 && elems[BIG_LENGTH/2] == 0 && elems[BIG_LENGTH-1] == 0;
+		aligned = aligned && ((size_t) arr % Heap::LARGE_OBJECT_PAGE) == Heap::LARGE_OBJECT_HEADER_SIZE; // the pages start with the header
+
+		elems[BIG_LENGTH/2] = i+1; // dirty a page before the array dies
+	}
+
+	auto end = std::chrono::steady_clock::now();
+
+	std::cout << NUM_BIG_ARRAYS << " 8 MB arrays in " << std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count() << " ms\n";
+
+	internal_api->Collect();
+
+	size_t live_after = internal_api->heap.allocated_size;
+
+	char* medium = internal_api->AllocateZeroed(MEDIUM_SIZE);
+
+	TEST(zeroed && aligned, 1);
+	TEST(*(int*) (kept+sizeof(Type*)) == BIG_LENGTH && internal_api->GetTypeOf(kept) == long_array_type, 2);
+	TEST(live_after < 2*BIG_LENGTH*sizeof(long long), 3); // the dead arrays' pages were released, only the kept one is left
+	TEST(internal_api->heap.FindContainingObject(medium+MEDIUM_SIZE-1) == medium && internal_api->heap.SizeOf(medium) == 20480, 4); // in a size class
+	TEST(internal_api->AllocateArray(long_array_type, (size_t) INT_MAX+1) == nullptr, 5);
+
+	return 0;
+}
+
+char ulrmeta[] = "pc[]Program:[System]Object,$8;.ctor p();.entr s[System]Int32 Main([System]String[]);\n";
+
+void* ulraddr[] = {
+	(void*) overload0_ns0_Program_ctor,
+	(void*) overload0_ns0_Program_Main
+};
+
+char* ulrdeps[] = { nullptr };
+
+END_ULR_EXPORT
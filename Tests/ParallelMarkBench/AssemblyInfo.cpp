@@ -0,0 +1,110 @@
+﻿#define TEST(condition, num) if (condition) std::cout << "+ Test " << num << " passed!\n"; else std::cout << "- Test " << num << " failed :(\n";
+
+#include <StdULR.hpp>
+#include <iostream>
+#include <chrono>
+#include <thread>
+
+const size_t TREE_DEPTH = 20; // ~2M nodes
+const size_t NODE_SIZE = sizeof(Type*)+16;
+
+Type* node_type;
+
+char* BuildTree(size_t depth)
+{
+	char* node = internal_api->AllocateZeroedNoGC(NODE_SIZE);
+
+	*(Type**) node = node_type;
+
+	if (depth == 0) return node;
+
+	*(char**) (node+8) = BuildTree(depth-1);
+	*(char**) (node+16) = BuildTree(depth-1);
+
+	return node;
+}
+
+BEGIN_ULR_EXPORT
+
+void InitAssembly(ULRAPIImpl* ulr)
+{
+	internal_api = ulr;
+}
+
+void overload0_ns0_Program_ctor(char* self) {}
+
+void overload0_ns0_Node_ctor(char* self) {}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Main(char* argv)
+{
+	char* framebase;
+
+	asm(
+		"mov %0, rbp\n\t"
+		:"=r"(framebase)
+	);
+
+	framebase-=sizeof(char*); // skip all "framebase" itself;
+
+	internal_api->InitGCLocalVarRoot((char**) framebase);
+
+	node_type = internal_api->GetType("[]Node");
+
+	char* volatile root = BuildTree(TREE_DEPTH); // kept on the stack, so the whole tree is reachable
+
+	char* framelimit;
+
+	asm(
+		"mov %0, rsp\n\t"
+		:"=r"(framelimit)
+	);
+
+	internal_api->InitGCLocalVarEnd((char**) framelimit); // only scan Main's frame for roots
+
+	bool nothing_collected = true;
+
+	unsigned int max_workers = std::max(std::thread::hardware_concurrency(), 1u);
+
+	for (unsigned int num_workers = 1; num_workers <= max_workers; num_workers*=2)
+	{
+		internal_api->SetGCWorkerCount(num_workers);
+
+		internal_api->Collect(); // starts the workers, so that the timed collection doesn't include spawning them
+
+		auto start = std::chrono::steady_clock::now();
+
+		GCResult result = internal_api->Collect();
+
+		auto end = std::chrono::steady_clock::now();
+
+		if (result.num_collected != 0) nothing_collected = false;
+
+		std::cout
+			<< num_workers << " GC workers: "
+			<< std::chrono::duration_cast<std::chrono::microseconds>(end-start).count()
+			<< " us pause\n";
+	}
+
+	char* leaf = root;
+
+	for (size_t i = 0; i < TREE_DEPTH; i++) leaf = *(char**) (leaf+((i % 2) ? 16 : 8));
+
+	TEST(nothing_collected, 1);
+	TEST(internal_api->heap.FindObject(leaf) == leaf, 2);
+
+	return 0;
+}
+
+char ulrmeta[] = "pc[]Program:[System]Object,$8;.ctor p();.entr s[System]Int32 Main([System]String[]);\npc[]Node:[System]Object,$24;.ctor p();.fldv p[]Node Left;.fldv p[]Node Right;\n";
+
+void* ulraddr[] = {
+	(void*) overload0_ns0_Program_ctor,
+	(void*) overload0_ns0_Program_Main,
+	(void*) overload0_ns0_Node_ctor,
+	(void*) 8,
+	(void*) 16
+};
+
+char* ulrdeps[] = { nullptr };
+
+END_ULR_EXPORT
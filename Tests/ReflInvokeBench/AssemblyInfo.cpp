@@ -0,0 +1,115 @@
+﻿#define TEST(condition, num) if (condition) std::cout << "+ Test " << num << " passed!\n"; else std::cout << "- Test " << num << " failed :(\n";
+
+#include <StdULR.hpp>
+#include <iostream>
+#include <chrono>
+
+const size_t NUM_CALLS = 1000000;
+
+BEGIN_ULR_EXPORT
+
+void InitAssembly(ULRAPIImpl* ulr)
+{
+	internal_api = ulr;
+}
+
+void overload0_ns0_Program_ctor(char* self) {}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Main(char* argv)
+{
+	char* framebase;
+
+	asm(
+		"mov %0, rbp\n\t"
+		:"=r"(framebase)
+	);
+
+	framebase-=sizeof(char*); // skip all "framebase" itself;
+
+	internal_api->InitGCLocalVarRoot((char**) framebase);
+
+	Type* ProgramType = internal_api->GetType("[]Program");
+	Type* SystemInt32Type = internal_api->GetType("[System]Int32");
+	Type* SystemInt64Type = internal_api->GetType("[System]Int64");
+
+	MethodInfo* sub = internal_api->GetMethod(ProgramType, "Sub", { SystemInt32Type, SystemInt32Type });
+	MethodInfo* max = internal_api->GetMethod(ProgramType, "Max", { SystemInt32Type, SystemInt32Type });
+	MethodInfo* weighted = internal_api->GetMethod(
+		ProgramType, "Weighted",
+		{ SystemInt64Type, SystemInt64Type, SystemInt64Type, SystemInt64Type, SystemInt64Type, SystemInt64Type, SystemInt64Type }
+	);
+
+	TEST(sub && max && weighted, 0);
+
+	int a = 10;
+	int b = 3;
+
+	char* boxed_a = internal_api->Box<sizeof_ns1_System_Int32>(a, SystemInt32Type);
+	char* boxed_b = internal_api->Box<sizeof_ns1_System_Int32>(b, SystemInt32Type);
+
+	TEST(internal_api->UnBox<sizeof_ns1_System_Int32>(sub->Invoke(nullptr, { boxed_a, boxed_b })) == 7, 1);
+
+	size_t num_stubs = internal_api->invoke_stubs.NumStubs();
+
+	TEST(internal_api->UnBox<sizeof_ns1_System_Int32>(max->Invoke(nullptr, { boxed_a, boxed_b })) == 10, 2);
+	TEST(internal_api->invoke_stubs.NumStubs() == num_stubs && max->invoke_stub == sub->invoke_stub, 3); // same signature shape, same stub
+
+	std::vector<char*> longs;
+
+	for (int64_t i = 1; i <= 7; i++) longs.push_back(internal_api->Box<sizeof_ns1_System_Int64>(i, SystemInt64Type));
+
+	TEST(internal_api->UnBox<sizeof_ns1_System_Int64>(weighted->Invoke(nullptr, longs)) == 1*1+2*2+3*3+4*4+5*5+6*6+7*7, 4); // three of them on the stack
+
+	std::vector<char*> args = { boxed_a, boxed_b };
+
+	int checksum = 0;
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < NUM_CALLS; i++) checksum+=internal_api->UnBox<sizeof_ns1_System_Int32>(sub->Invoke(nullptr, args));
+
+	auto end = std::chrono::steady_clock::now();
+
+	std::cout << "Invoke: " << std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count()/NUM_CALLS << " ns/call\n";
+
+	TEST(checksum == 7*NUM_CALLS, 5);
+
+	return 0;
+}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Sub(sizeof_ns1_System_Int32 a, sizeof_ns1_System_Int32 b)
+{
+	return a-b;
+}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Max(sizeof_ns1_System_Int32 a, sizeof_ns1_System_Int32 b)
+{
+	return (a > b) ? a : b;
+}
+
+sizeof_ns1_System_Int64 overload0_ns0_Program_Weighted(
+	sizeof_ns1_System_Int64 a,
+	sizeof_ns1_System_Int64 b,
+	sizeof_ns1_System_Int64 c,
+	sizeof_ns1_System_Int64 d,
+	sizeof_ns1_System_Int64 e,
+	sizeof_ns1_System_Int64 f,
+	sizeof_ns1_System_Int64 g
+)
+{
+	return a*1+b*2+c*3+d*4+e*5+f*6+g*7;
+}
+
+char ulrmeta[] = "pc[]Program:[System]Object,$8;.ctor p();.entr s[System]Int32 Main([System]String[]);s[System]Int32 Sub([System]Int32,[System]Int32);s[System]Int32 Max([System]Int32,[System]Int32);s[System]Int64 Weighted([System]Int64,[System]Int64,[System]Int64,[System]Int64,[System]Int64,[System]Int64,[System]Int64);\n";
+
+void* ulraddr[] = {
+	(void*) overload0_ns0_Program_ctor,
+	(void*) overload0_ns0_Program_Main,
+	(void*) overload0_ns0_Program_Sub,
+	(void*) overload0_ns0_Program_Max,
+	(void*) overload0_ns0_Program_Weighted
+};
+
+char* ulrdeps[] = { nullptr };
+
+END_ULR_EXPORT
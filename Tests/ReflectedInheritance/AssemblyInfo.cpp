@@ -43,7 +43,7 @@ sizeof_ns1_System_Int32 overload0_ns0_Program_Main(char* argv)
 	return 0;
 }
 
-sizeof_ns1_System_Int32 overload0_ns0_Program_Method()
+sizeof_ns1_System_Int32 overload0_ns0_Program_Method(char* self)
 {
 	TEST(true, 5);
 
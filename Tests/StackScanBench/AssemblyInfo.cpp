@@ -0,0 +1,108 @@
+﻿#define TEST(condition, num) if (condition) std::cout << "+ Test " << num << " passed!\n"; else std::cout << "- Test " << num << " failed :(\n";
+
+#include <StdULR.hpp>
+#include <iostream>
+#include <chrono>
+#include <random>
+
+const size_t FRAME_WORDS = 1024; // 8 KB of non-pointer data per frame
+const size_t MAX_DEPTH = 64; // 512 KB of stack at the deepest point
+const size_t NUM_COLLECTIONS = 10;
+
+Type* program_type;
+char* interior_target;
+bool interior_survived = false;
+
+// only a ptr to the middle of the object is kept on the stack
+__attribute__((noinline)) char* AllocateInterior()
+{
+	char* obj = internal_api->AllocateObject(program_type->size);
+
+	*(Type**) obj = program_type;
+
+	interior_target = obj;
+
+	return obj+16;
+}
+
+__attribute__((noinline)) void Recurse(size_t depth, std::mt19937_64& rng)
+{
+	volatile uint64_t frame[FRAME_WORDS];
+
+	for (size_t i = 0; i < FRAME_WORDS; i++) frame[i] = rng(); // looks nothing like heap ptrs, like most stack data
+
+	if (depth < MAX_DEPTH)
+	{
+		Recurse(depth+1, rng);
+
+		return;
+	}
+
+	char* volatile inner = AllocateInterior();
+
+	char* framelimit;
+
+	asm(
+		"mov %0, rsp\n\t"
+		:"=r"(framelimit)
+	);
+
+	internal_api->InitGCLocalVarEnd((char**) framelimit);
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < NUM_COLLECTIONS; i++) internal_api->Collect();
+
+	auto end = std::chrono::steady_clock::now();
+
+	std::cout
+		<< (MAX_DEPTH*FRAME_WORDS*sizeof(uint64_t))/1024 << " KB of stack: "
+		<< std::chrono::duration_cast<std::chrono::microseconds>(end-start).count()/NUM_COLLECTIONS
+		<< " us per collection\n";
+
+	interior_survived = (internal_api->heap.FindObject(interior_target) == interior_target) && (internal_api->GetTypeOf(interior_target) == program_type) && inner;
+}
+
+BEGIN_ULR_EXPORT
+
+void InitAssembly(ULRAPIImpl* ulr)
+{
+	internal_api = ulr;
+}
+
+void overload0_ns0_Program_ctor(char* self) {}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Main(char* argv)
+{
+	char* framebase;
+
+	asm(
+		"mov %0, rbp\n\t"
+		:"=r"(framebase)
+	);
+
+	framebase-=sizeof(char*); // skip all "framebase" itself;
+
+	internal_api->InitGCLocalVarRoot((char**) framebase);
+
+	program_type = internal_api->GetType("[]Program");
+
+	std::mt19937_64 rng(42);
+
+	Recurse(0, rng);
+
+	TEST(interior_survived, 1);
+
+	return 0;
+}
+
+char ulrmeta[] = "pc[]Program:[System]Object,$40;.ctor p();.entr s[System]Int32 Main([System]String[]);\n";
+
+void* ulraddr[] = {
+	(void*) overload0_ns0_Program_ctor,
+	(void*) overload0_ns0_Program_Main
+};
+
+char* ulrdeps[] = { nullptr };
+
+END_ULR_EXPORT
@@ -0,0 +1,67 @@
+﻿#define TEST(condition, num) if (condition) std::cout << "+ Test " << num << " passed!\n"; else std::cout << "- Test " << num << " failed :(\n";
+
+#include <StdULR.hpp>
+#include <iostream>
+#include <chrono>
+#include <string>
+
+const int TRACE_DEPTH = 28; // + Main and the entry point = the 30 frames a trace holds at most
+const size_t TRACE_ROUNDS = 1000;
+
+std::string last_trace;
+
+BEGIN_ULR_EXPORT
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Recurse(sizeof_ns1_System_Int32 depth);
+
+void InitAssembly(ULRAPIImpl* ulr)
+{
+	internal_api = ulr;
+}
+
+void overload0_ns0_Program_ctor(char* self) {}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Main(char* argv)
+{
+	overload0_ns0_Program_Recurse(TRACE_DEPTH);
+
+	TEST(last_trace.find("Recurse") != std::string::npos, 1);
+	TEST(internal_api->ResolveAddressToMember((void*) overload0_ns0_Program_Recurse) == internal_api->GetMethod(internal_api->GetType("[]Program"), "Recurse", { internal_api->GetType("[System]Int32") }), 2);
+
+	return 0;
+}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Recurse(sizeof_ns1_System_Int32 depth)
+{
+	if (depth > 0) return overload0_ns0_Program_Recurse(depth-1)+1; // not a tail call, every level keeps its frame
+
+	internal_api->GetStackTrace(0); // first trace pays for symbol handler initialization
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (size_t round = 0; round < TRACE_ROUNDS; round++)
+	{
+		last_trace = internal_api->GetStackTrace(0);
+	}
+
+	auto end = std::chrono::steady_clock::now();
+
+	std::cout
+		<< "30-frame stack trace: "
+		<< std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count()/TRACE_ROUNDS
+		<< " ns/trace\n";
+
+	return 0;
+}
+
+char ulrmeta[] = "pc[]Program:[System]Object,$8;.ctor p();.entr s[System]Int32 Main([System]String[]);s[System]Int32 Recurse([System]Int32);\n";
+
+void* ulraddr[] = {
+	(void*) overload0_ns0_Program_ctor,
+	(void*) overload0_ns0_Program_Main,
+	(void*) overload0_ns0_Program_Recurse
+};
+
+char* ulrdeps[] = { nullptr };
+
+END_ULR_EXPORT
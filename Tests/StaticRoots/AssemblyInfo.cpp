@@ -0,0 +1,85 @@
+﻿#define TEST(condition, num) if (condition) std::cout << "+ Test " << num << " passed!\n"; else std::cout << "- Test " << num << " failed :(\n";
+
+#include <StdULR.hpp>
+#include <iostream>
+
+const size_t NUM_NODES = 1000;
+const size_t NODE_SIZE = sizeof(Type*)+24;
+
+char* root_storage = nullptr; // Node.Root
+
+BEGIN_ULR_EXPORT
+
+void InitAssembly(ULRAPIImpl* ulr)
+{
+	internal_api = ulr;
+}
+
+void overload0_ns0_Program_ctor(char* self) {}
+
+void overload0_ns0_Node_ctor(char* self) {}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Main(char* argv)
+{
+	char* framebase;
+
+	asm(
+		"mov %0, rbp\n\t"
+		:"=r"(framebase)
+	);
+
+	framebase-=sizeof(char*); // skip all "framebase" itself;
+
+	internal_api->InitGCLocalVarRoot((char**) framebase);
+
+	Type* node_type = internal_api->GetType("[]Node");
+
+	for (size_t i = 0; i < NUM_NODES; i++) // only reachable through the static field
+	{
+		char* node = internal_api->AllocateZeroed(NODE_SIZE);
+
+		*(Type**) node = node_type;
+		*(char**) (node+8) = root_storage;
+
+		ULR_WRITE_BARRIER(node);
+
+		root_storage = node;
+	}
+
+	internal_api->Collect();
+
+	Heap::GCEvent event;
+
+	internal_api->gc_telemetry.GetRecentEvents(&event, 1);
+
+	size_t num_alive = 0;
+
+	for (char* node = root_storage; node && internal_api->heap.FindObject(node); node = *(char**) (node+8)) num_alive++;
+
+	TEST(num_alive == NUM_NODES, 1);
+	TEST(event.static_roots_scanned >= 1, 2);
+
+	size_t size_before = internal_api->heap.allocated_size;
+
+	root_storage = nullptr;
+
+	internal_api->Collect();
+
+	TEST(size_before-internal_api->heap.allocated_size >= NUM_NODES*NODE_SIZE, 3);
+
+	return 0;
+}
+
+char ulrmeta[] = "pc[]Program:[System]Object,$8;.ctor p();.entr s[System]Int32 Main([System]String[]);\npc[]Node:[System]Object,$32;.ctor p();.fldv p[]Node Next;.fldv ps[]Node Root;\n";
+
+void* ulraddr[] = {
+	(void*) overload0_ns0_Program_ctor,
+	(void*) overload0_ns0_Program_Main,
+	(void*) overload0_ns0_Node_ctor,
+	(void*) 8,
+	(void*) &root_storage
+};
+
+char* ulrdeps[] = { nullptr };
+
+END_ULR_EXPORT
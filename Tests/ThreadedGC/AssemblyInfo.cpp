@@ -0,0 +1,107 @@
+﻿#define TEST(condition, num) if (condition) std::cout << "+ Test " << num << " passed!\n"; else std::cout << "- Test " << num << " failed :(\n";
+
+#include <StdULR.hpp>
+#include <iostream>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+const size_t NUM_THREADS = 4;
+const size_t ALLOCS_PER_THREAD = 2000000; // 64 MB per thread, enough for several nursery collections
+
+Type* program_type;
+std::atomic<size_t> num_survived { 0 };
+
+void Mutate()
+{
+	char* framebase;
+
+	asm(
+		"mov %0, rbp\n\t"
+		:"=r"(framebase)
+	);
+
+	internal_api->InitGCLocalVarRoot((char**) framebase);
+
+	char* volatile kept = internal_api->AllocateObject(program_type->size); // only referenced by this thread's stack
+
+	*(Type**) kept = program_type;
+
+	for (size_t i = 0; i < ALLOCS_PER_THREAD; i++)
+	{
+		char* garbage = internal_api->AllocateObject(program_type->size); // polls the safepoint
+
+		*(Type**) garbage = program_type;
+	}
+
+	if (internal_api->heap.FindObject(kept) == kept && internal_api->GetTypeOf(kept) == program_type) num_survived++;
+
+	internal_api->DetachThread();
+}
+
+// never reaches a safepoint, so collections have to suspend it
+void Spin(std::atomic<bool>& stop)
+{
+	char* framebase;
+
+	asm(
+		"mov %0, rbp\n\t"
+		:"=r"(framebase)
+	);
+
+	internal_api->InitGCLocalVarRoot((char**) framebase);
+
+	while (!stop) ;
+
+	internal_api->DetachThread();
+}
+
+BEGIN_ULR_EXPORT
+
+void InitAssembly(ULRAPIImpl* ulr)
+{
+	internal_api = ulr;
+}
+
+void overload0_ns0_Program_ctor(char* self) {}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Main(char* argv)
+{
+	program_type = internal_api->GetType("[]Program");
+
+	std::atomic<bool> stop_spinning { false };
+
+	std::thread spinner(Spin, std::ref(stop_spinning));
+	std::vector<std::thread> mutators;
+
+	for (size_t i = 0; i < NUM_THREADS; i++) mutators.emplace_back(Mutate);
+
+	internal_api->EnterNative(); // joining blocks
+
+	for (auto& mutator : mutators) mutator.join();
+
+	internal_api->LeaveNative();
+
+	GCResult result = internal_api->Collect(); // the spinner is suspended
+
+	stop_spinning = true;
+
+	spinner.join();
+
+	TEST(num_survived == NUM_THREADS, 1);
+	TEST(result.num_collected > 0, 2);
+	TEST(!internal_api->safepoint_requested, 3);
+
+	return 0;
+}
+
+char ulrmeta[] = "pc[]Program:[System]Object,$32;.ctor p();.entr s[System]Int32 Main([System]String[]);\n";
+
+void* ulraddr[] = {
+	(void*) overload0_ns0_Program_ctor,
+	(void*) overload0_ns0_Program_Main
+};
+
+char* ulrdeps[] = { nullptr };
+
+END_ULR_EXPORT
@@ -0,0 +1,117 @@
+﻿#define TEST(condition, num) if (condition) std::cout << "+ Test " << num << " passed!\n"; else std::cout << "- Test " << num << " failed :(\n";
+
+#include <StdULR.hpp>
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+
+const size_t TYPES_PER_ASSEMBLY = 10;
+const size_t LOOKUP_ROUNDS = 1000;
+
+// the lookup that ULRAPIImpl::GetType performed before the type index existed
+Type* LinearGetType(std::string_view full_qual_typename)
+{
+	for (auto& entry : *internal_api->assemblies)
+	{
+		auto& assembly = entry.second;
+
+		if (assembly->types.count(full_qual_typename) != 0) return assembly->types[full_qual_typename];
+	}
+
+	return nullptr;
+}
+
+void AddBenchAssemblies(size_t from, size_t to, std::vector<std::string>& names)
+{
+	for (size_t a = from; a < to; a++)
+	{
+		Assembly* assembly = new Assembly(strdup(("TypeLookupBench.Synthetic"+std::to_string(a)+".dll").c_str()), strdup(""), "", 0, { }, { nullptr }, (HMODULE) nullptr);
+
+		for (size_t t = 0; t < TYPES_PER_ASSEMBLY; t++)
+		{
+			Type* type = new Type(TypeType::Class, assembly, strdup(("[Bench"+std::to_string(a)+"]Type"+std::to_string(t)).c_str()), Modifiers::Public, 8, { }, nullptr, false, 0);
+
+			internal_api->PopulateVtablePtr(type);
+
+			assembly->types[type->name] = type;
+			internal_api->RegisterType(type);
+
+			names.emplace_back(type->name);
+		}
+
+		(*internal_api->read_assemblies)[assembly->name] = assembly;
+		(*internal_api->assemblies)[assembly->name] = assembly;
+	}
+}
+
+BEGIN_ULR_EXPORT
+
+void InitAssembly(ULRAPIImpl* ulr)
+{
+	internal_api = ulr;
+}
+
+void overload0_ns0_Program_ctor(char* self) {}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Main(char* argv)
+{
+	std::vector<std::string> names;
+	size_t num_assemblies = 0;
+	bool all_matched = true;
+
+	for (size_t checkpoint : { 10, 100, 1000 })
+	{
+		AddBenchAssemblies(num_assemblies, checkpoint, names);
+
+		num_assemblies = checkpoint;
+
+		size_t found = 0;
+
+		auto linear_start = std::chrono::steady_clock::now();
+
+		for (size_t round = 0; round < LOOKUP_ROUNDS; round++)
+		{
+			if (LinearGetType(names[(round*7919) % names.size()])) found++;
+		}
+
+		auto linear_end = std::chrono::steady_clock::now();
+
+		for (size_t round = 0; round < LOOKUP_ROUNDS; round++)
+		{
+			if (internal_api->GetType(names[(round*7919) % names.size()])) found++;
+		}
+
+		auto indexed_end = std::chrono::steady_clock::now();
+
+		for (auto& name : names)
+		{
+			if (LinearGetType(name) != internal_api->GetType(name)) all_matched = false;
+		}
+
+		all_matched = all_matched && (found == LOOKUP_ROUNDS*2);
+
+		std::cout
+			<< num_assemblies << " assemblies: linear scan "
+			<< std::chrono::duration_cast<std::chrono::nanoseconds>(linear_end-linear_start).count()/LOOKUP_ROUNDS
+			<< " ns/lookup, type index "
+			<< std::chrono::duration_cast<std::chrono::nanoseconds>(indexed_end-linear_end).count()/LOOKUP_ROUNDS
+			<< " ns/lookup\n";
+	}
+
+	TEST(all_matched, 1);
+	TEST(internal_api->GetType("[]Program") == LinearGetType("[]Program"), 2);
+
+	return 0;
+}
+
+char ulrmeta[] = "pc[]Program:[System]Object,$8;.ctor p();.entr s[System]Int32 Main([System]String[]);\n";
+
+void* ulraddr[] = {
+	(void*) overload0_ns0_Program_ctor,
+	(void*) overload0_ns0_Program_Main
+};
+
+char* ulrdeps[] = { nullptr };
+
+END_ULR_EXPORT
@@ -0,0 +1,119 @@
+﻿#define TEST(condition, num) if (condition) std::cout << "+ Test " << num << " passed!\n"; else std::cout << "- Test " << num << " failed :(\n";
+
+#include <StdULR.hpp>
+#include <iostream>
+
+const size_t NUM_CALLS = 1000000;
+
+sizeof_ns1_System_Int32 count = 0;
+
+BEGIN_ULR_EXPORT
+
+void InitAssembly(ULRAPIImpl* ulr)
+{
+	internal_api = ulr;
+}
+
+void overload0_ns0_Program_ctor(char* self) {}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Main(char* argv)
+{
+	char* framebase;
+
+	asm(
+		"mov %0, rbp\n\t"
+		:"=r"(framebase)
+	);
+
+	framebase-=sizeof(char*); // skip all "framebase" itself;
+
+	internal_api->InitGCLocalVarRoot((char**) framebase);
+
+	Type* ProgramType = internal_api->GetType("[]Program");
+	Type* SystemInt32Type = internal_api->GetType("[System]Int32");
+	Type* SystemObjectType = internal_api->GetType("[System]Object");
+
+	MethodInfo* sub = internal_api->GetMethod(ProgramType, "Sub", { SystemInt32Type, SystemInt32Type });
+	MethodInfo* pick = internal_api->GetMethod(ProgramType, "Pick", { SystemObjectType, SystemInt32Type });
+	PropertyInfo* prop = internal_api->GetProperty(ProgramType, "Count", BindingFlags::Public | BindingFlags::Static);
+
+	TEST(sub && pick && prop, 0);
+
+	sizeof_ns1_System_Int32 a = 10;
+	sizeof_ns1_System_Int32 b = 3;
+	sizeof_ns1_System_Int32 ret = 0;
+
+	void* args[] = { &a, &b };
+
+	sub->InvokeUnboxed(nullptr, args, &ret);
+
+	TEST(ret == 7, 1);
+
+	char* obj = internal_api->AllocateObject(sizeof(Type*));
+	char* picked = nullptr;
+
+	void* pick_args[] = { &obj, &a }; // ref args point to the variable holding the ref
+
+	pick->InvokeUnboxed(nullptr, pick_args, &picked);
+
+	TEST(picked == obj, 2);
+
+	sizeof_ns1_System_Int32 value = 42;
+
+	prop->SetValueUnboxed(nullptr, &value);
+	prop->GetValueUnboxed(nullptr, &ret);
+
+	TEST(count == 42 && ret == 42, 3);
+
+	size_t size_before = internal_api->heap.allocated_size;
+	sizeof_ns1_System_Int32 checksum = 0;
+
+	for (size_t i = 0; i < NUM_CALLS; i++)
+	{
+		prop->GetValueUnboxed(nullptr, &ret);
+		checksum+=ret;
+
+		sub->InvokeUnboxed(nullptr, args, &ret);
+		checksum+=ret;
+	}
+
+	TEST(checksum == (42+7)*NUM_CALLS, 4);
+	TEST(internal_api->heap.allocated_size == size_before, 5); // nothing was boxed
+
+	return 0;
+}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_Sub(sizeof_ns1_System_Int32 a, sizeof_ns1_System_Int32 b)
+{
+	return a-b;
+}
+
+char* overload0_ns0_Program_Pick(char* obj, sizeof_ns1_System_Int32 index)
+{
+	return index ? obj : nullptr;
+}
+
+sizeof_ns1_System_Int32 overload0_ns0_Program_get_Count()
+{
+	return count;
+}
+
+void overload0_ns0_Program_set_Count(sizeof_ns1_System_Int32 value)
+{
+	count = value;
+}
+
+char ulrmeta[] = "pc[]Program:[System]Object,$8;.ctor p();.entr s[System]Int32 Main([System]String[]);s[System]Int32 Sub([System]Int32,[System]Int32);s[System]Object Pick([System]Object,[System]Int32);.prop psgw[System]Int32 Count;\n";
+
+void* ulraddr[] = {
+	(void*) overload0_ns0_Program_ctor,
+	(void*) overload0_ns0_Program_Main,
+	(void*) overload0_ns0_Program_Sub,
+	(void*) overload0_ns0_Program_Pick,
+	(void*) overload0_ns0_Program_get_Count,
+	(void*) overload0_ns0_Program_set_Count
+};
+
+char* ulrdeps[] = { nullptr };
+
+END_ULR_EXPORT
@@ -0,0 +1,24 @@
+#include "Assembly.hpp"
+#include <atomic>
+#include <vector>
+
+#pragma once
+
+namespace ULR
+{
+	// everything needed to create an instance of a type, resolved once (see ULRAPIImpl::CreateInstance)
+	struct Activator
+	{
+		Type* type;
+		size_t alloc_size; // structs are created boxed
+		size_t this_offset; // struct ctors take a ptr to the data
+		bool zero_init; // the instance holds refs, which a collection during the ctor would otherwise scan as garbage
+		void (*default_ctor)(char* self) = nullptr; // called directly, nullptr if there is no parameterless ctor
+		std::vector<ConstructorInfo*> ctors; // the others
+		std::atomic<ConstructorInfo*> last_ctor { nullptr }; // checked first, callers tend to use the same ctor over and over
+
+		Activator(Type* type);
+
+		ConstructorInfo* FindCtor(Type* const* argsig, size_t nargs); // nullptr if there is none
+	};
+}
@@ -0,0 +1,54 @@
+#include "../Activator.hpp"
+#include "../Resolver.hpp"
+#include <algorithm>
+
+namespace ULR
+{
+	static bool SignatureMatches(ConstructorInfo* ctor, Type* const* argsig, size_t nargs)
+	{
+		return (ctor->argsig.size() == nargs) && std::equal(argsig, argsig+nargs, ctor->argsig.begin());
+	}
+
+	Activator::Activator(Type* type)
+	{
+		this->type = type;
+		this->alloc_size = IsBoxableStruct(type) ? sizeof(Type*)+type->size : type->size;
+		this->this_offset = IsBoxableStruct(type) ? sizeof(Type*) : 0;
+
+		internal_api->EnsureGCMap(type); // GC workers may be building it at the same time
+
+		this->zero_init = !type->gc_ptr_offsets.empty();
+
+		auto found = type->static_attrs.find(".ctor");
+
+		if (found == type->static_attrs.end()) return;
+
+		for (MemberInfo* member : found->second)
+		{
+			ConstructorInfo* ctor = (ConstructorInfo*) member;
+
+			if (ctor->is_empty_generic) continue;
+
+			if (ctor->argsig.empty()) default_ctor = (void (*)(char*)) ctor->offset;
+			else ctors.push_back(ctor);
+		}
+	}
+
+	ConstructorInfo* Activator::FindCtor(Type* const* argsig, size_t nargs)
+	{
+		ConstructorInfo* last = last_ctor.load(std::memory_order_relaxed);
+
+		if (last && SignatureMatches(last, argsig, nargs)) return last;
+
+		for (ConstructorInfo* ctor : ctors)
+		{
+			if (!SignatureMatches(ctor, argsig, nargs)) continue;
+
+			last_ctor.store(ctor, std::memory_order_relaxed);
+
+			return ctor;
+		}
+
+		return nullptr;
+	}
+}
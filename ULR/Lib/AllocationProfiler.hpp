@@ -0,0 +1,83 @@
+#include "Assembly.hpp"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#pragma once
+
+namespace ULR::Resolver
+{
+	// estimates, scaled up from the samples
+	struct AllocationStats
+	{
+		size_t num_samples = 0;
+		double num_objects = 0;
+		double size = 0;
+	};
+
+	/*
+		Opt-in sampling heap profiler: on average every sample_interval bytes (the gaps are random, so periodic allocation patterns can't alias with them)
+		an allocation records the return addresses of its thread's stack. The allocated Type* is read from the object header once it has been written,
+		which is the next time the profiler takes its lock (at the latest the next collection, before the object's cell can be reused).
+		When disabled the only cost is a relaxed load at each allocation.
+	*/
+	class AllocationProfiler
+	{
+		struct PendingSample
+		{
+			char* obj;
+			size_t size;
+			std::vector<void*> frames; // innermost first
+		};
+
+		std::mutex profile_lock;
+		std::atomic<size_t> sample_interval { 512*1024 };
+		std::atomic<uint64_t> generation { 0 }; // bumped by Start, so that threads redraw their sampling gaps
+		std::vector<PendingSample> pending;
+		std::map<std::pair<Type*, std::vector<void*>>, AllocationStats> sites;
+		std::unordered_map<Type*, AllocationStats> types;
+
+		static thread_local int64_t bytes_until_sample;
+		static thread_local uint64_t thread_generation;
+
+		void Sample(char* obj, size_t size);
+		void ResolvePending(bool at_collection);
+		void Record(Type* type, size_t size, std::vector<void*>& frames);
+		// the managed part of the stack, outermost first, with the allocated type as the leaf frame
+		std::vector<std::string> SiteFrames(const std::pair<Type*, std::vector<void*>>& site, std::unordered_map<void*, std::string>& frame_names);
+
+		public:
+			std::atomic<bool> enabled { false };
+
+			void Start(size_t sample_interval); // bytes, also clears the previous profile
+			void Stop();
+			void Reset();
+
+			// must only be called when enabled, after the object is allocated and before its header is written
+			inline void OnAllocation(char* obj, size_t size)
+			{
+				bytes_until_sample-=size;
+
+				if (bytes_until_sample > 0 && thread_generation == generation.load(std::memory_order_relaxed)) return;
+
+				Sample(obj, size);
+			}
+
+			// taken by collections before they stop the other threads, so that no stopped thread can be holding it when OnCollection runs
+			std::unique_lock<std::mutex> LockForCollection() { return std::unique_lock<std::mutex>(profile_lock); }
+			// called by collections with every other thread stopped, under the lock from LockForCollection
+			void OnCollection();
+
+			std::vector<std::pair<Type*, AllocationStats>> GetTypeStats(); // largest first
+
+			// flame graph input: one "outer;...;inner;Type bytes" line per site
+			void WriteFolded(std::ostream& out);
+			// uncompressed pprof protobuf, with alloc_objects and alloc_space sample values
+			void WritePprof(std::ostream& out);
+	};
+}
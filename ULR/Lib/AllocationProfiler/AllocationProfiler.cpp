@@ -0,0 +1,317 @@
+#include "../AllocationProfiler.hpp"
+#include "../Resolver.hpp"
+#include <chrono>
+#include <cmath>
+
+const size_t MAX_PROFILE_FRAMES = 32;
+
+namespace ULR::Resolver
+{
+	thread_local int64_t AllocationProfiler::bytes_until_sample = 0;
+	thread_local uint64_t AllocationProfiler::thread_generation = 0;
+
+	static thread_local uint64_t rng_state = 0;
+
+	// exponentially distributed, so that sampling is a Poisson process over the allocated bytes
+	static int64_t NextSampleGap(size_t mean)
+	{
+		if (!rng_state) rng_state = ((uint64_t) &rng_state) ^ std::chrono::steady_clock::now().time_since_epoch().count() ^ 0x9E3779B97F4A7C15;
+
+		// xorshift64
+		rng_state ^= rng_state << 13;
+		rng_state ^= rng_state >> 7;
+		rng_state ^= rng_state << 17;
+
+		double uniform = ((rng_state >> 11)+1)*(1.0/9007199254740992.0); // (0, 1]
+
+		return (int64_t) (-log(uniform)*mean)+1;
+	}
+
+	void AllocationProfiler::Sample(char* obj, size_t size)
+	{
+		uint64_t current_generation = generation.load(std::memory_order_relaxed);
+		bool due = thread_generation == current_generation; // a gap drawn before Start is just redrawn
+
+		thread_generation = current_generation;
+		bytes_until_sample = NextSampleGap(sample_interval);
+
+		if (!due) return;
+
+		void* bt[MAX_PROFILE_FRAMES];
+
+		unsigned short num_frames = CaptureStackBackTrace(1, MAX_PROFILE_FRAMES, bt, NULL);
+
+		*(Type**) obj = nullptr; // the header is read once it has been written
+
+		std::lock_guard<std::mutex> lock(profile_lock);
+
+		ResolvePending(false);
+
+		pending.push_back({ obj, size, std::vector<void*>(bt, bt+num_frames) });
+	}
+
+	// objects whose header still isn't written at a collection are recorded with no type, their cells could be reused afterwards
+	void AllocationProfiler::ResolvePending(bool at_collection)
+	{
+		size_t kept = 0;
+
+		for (PendingSample& sample : pending)
+		{
+			Type* type = *(Type**) sample.obj;
+
+			if (type || at_collection) Record(type, sample.size, sample.frames);
+			else pending[kept++] = std::move(sample);
+		}
+
+		pending.resize(kept);
+	}
+
+	void AllocationProfiler::Record(Type* type, size_t size, std::vector<void*>& frames)
+	{
+		// the chance of a size byte allocation being sampled is 1-e^(-size/interval), each sample stands for the reciprocal of that
+		double scale = 1/(1-exp(-((double) size)/sample_interval));
+
+		AllocationStats& site = sites[{ type, frames }];
+		AllocationStats& type_stats = types[type];
+
+		for (AllocationStats* stats : { &site, &type_stats })
+		{
+			stats->num_samples++;
+			stats->num_objects+=scale;
+			stats->size+=scale*size;
+		}
+	}
+
+	void AllocationProfiler::OnCollection()
+	{
+		ResolvePending(true); // every pending sample, its cell may be reused once the sweep is done
+	}
+
+	void AllocationProfiler::Start(size_t sample_interval)
+	{
+		std::lock_guard<std::mutex> lock(profile_lock);
+
+		pending.clear();
+		sites.clear();
+		types.clear();
+
+		this->sample_interval = std::max(sample_interval, (size_t) 1);
+
+		generation++;
+		enabled = true;
+	}
+
+	void AllocationProfiler::Stop()
+	{
+		enabled = false;
+
+		std::lock_guard<std::mutex> lock(profile_lock);
+
+		ResolvePending(true);
+	}
+
+	void AllocationProfiler::Reset()
+	{
+		std::lock_guard<std::mutex> lock(profile_lock);
+
+		pending.clear();
+		sites.clear();
+		types.clear();
+	}
+
+	std::vector<std::pair<Type*, AllocationStats>> AllocationProfiler::GetTypeStats()
+	{
+		std::lock_guard<std::mutex> lock(profile_lock);
+
+		ResolvePending(false);
+
+		std::vector<std::pair<Type*, AllocationStats>> stats(types.begin(), types.end());
+
+		std::sort(stats.begin(), stats.end(), [](auto& a, auto& b) { return a.second.size > b.second.size; });
+
+		return stats;
+	}
+
+	std::vector<std::string> AllocationProfiler::SiteFrames(const std::pair<Type*, std::vector<void*>>& site, std::unordered_map<void*, std::string>& frame_names)
+	{
+		std::vector<std::string> frames;
+
+		// only managed frames are kept (JIT code and the functions of native assemblies), the runtime's and the host's are left out
+		for (auto it = site.second.rbegin(); it != site.second.rend(); it++)
+		{
+			auto cached = frame_names.find(*it);
+
+			if (cached == frame_names.end())
+			{
+				MemberInfo* member = internal_api->ResolveReturnAddressToMember(*it);
+
+				cached = frame_names.emplace(*it, member ? internal_api->GetFullyQualifiedNameOf(member) : "").first;
+			}
+
+			if (!cached->second.empty()) frames.push_back(cached->second);
+		}
+
+		if (frames.empty()) frames.push_back("[native]");
+
+		frames.push_back(site.first ? internal_api->GetDisplayNameOf(site.first) : "[unknown type]");
+
+		return frames;
+	}
+
+	void AllocationProfiler::WriteFolded(std::ostream& out)
+	{
+		std::lock_guard<std::mutex> lock(profile_lock);
+
+		ResolvePending(false);
+
+		std::unordered_map<void*, std::string> frame_names;
+		std::map<std::string, double> stacks; // sites that only differ in native frames are merged
+
+		for (auto& site : sites)
+		{
+			std::string stack;
+
+			for (std::string& frame : SiteFrames(site.first, frame_names))
+			{
+				if (!stack.empty()) stack.push_back(';');
+
+				stack.append(frame);
+			}
+
+			stacks[stack]+=site.second.size;
+		}
+
+		for (auto& stack : stacks) out << stack.first << ' ' << llround(stack.second) << '\n';
+	}
+
+	// minimal protobuf encoding, only what profile.proto needs
+
+	static void WriteVarint(std::string& out, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			out.push_back((char) (value | 0x80));
+
+			value >>= 7;
+		}
+
+		out.push_back((char) value);
+	}
+
+	static void WriteVarintField(std::string& out, int field, uint64_t value)
+	{
+		WriteVarint(out, field << 3);
+		WriteVarint(out, value);
+	}
+
+	static void WriteBytesField(std::string& out, int field, const std::string& bytes)
+	{
+		WriteVarint(out, (field << 3) | 2);
+		WriteVarint(out, bytes.size());
+
+		out.append(bytes);
+	}
+
+	void AllocationProfiler::WritePprof(std::ostream& out)
+	{
+		std::lock_guard<std::mutex> lock(profile_lock);
+
+		ResolvePending(false);
+
+		std::vector<std::string> strings = { "" };
+		std::unordered_map<std::string, uint64_t> string_ids = { { "", 0 } };
+
+		auto intern = [&](const std::string& str) {
+			auto it = string_ids.emplace(str, strings.size());
+
+			if (it.second) strings.push_back(str);
+
+			return it.first->second;
+		};
+
+		std::string profile;
+
+		auto write_value_type = [&](int field, const char* type, const char* unit) {
+			std::string value_type;
+
+			WriteVarintField(value_type, 1, intern(type));
+			WriteVarintField(value_type, 2, intern(unit));
+
+			WriteBytesField(profile, field, value_type);
+		};
+
+		write_value_type(1, "alloc_objects", "count"); // sample_type
+		write_value_type(1, "alloc_space", "bytes");
+		write_value_type(11, "space", "bytes"); // period_type
+
+		WriteVarintField(profile, 12, sample_interval); // period
+		WriteVarintField(profile, 14, intern("alloc_space")); // default_sample_type
+
+		// one location (and function) per frame name
+		std::unordered_map<std::string, uint64_t> location_ids;
+		std::unordered_map<void*, std::string> frame_names;
+		std::map<std::vector<uint64_t>, std::pair<double, double>> samples;
+
+		for (auto& site : sites)
+		{
+			std::vector<std::string> frames = SiteFrames(site.first, frame_names);
+			std::vector<uint64_t> locations;
+
+			for (auto frame = frames.rbegin(); frame != frames.rend(); frame++) // leaf first
+			{
+				auto location = location_ids.emplace(*frame, location_ids.size()+1);
+
+				if (location.second)
+				{
+					std::string function;
+
+					WriteVarintField(function, 1, location.first->second); // id
+					WriteVarintField(function, 2, intern(*frame)); // name
+					WriteVarintField(function, 3, intern(*frame)); // system_name
+
+					WriteBytesField(profile, 5, function);
+
+					std::string line;
+
+					WriteVarintField(line, 1, location.first->second); // function_id
+
+					std::string loc;
+
+					WriteVarintField(loc, 1, location.first->second); // id
+					WriteBytesField(loc, 4, line);
+
+					WriteBytesField(profile, 4, loc);
+				}
+
+				locations.push_back(location.first->second);
+			}
+
+			auto& values = samples[locations];
+
+			values.first+=site.second.num_objects;
+			values.second+=site.second.size;
+		}
+
+		for (auto& sample : samples)
+		{
+			std::string location_ids_packed;
+			std::string values_packed;
+
+			for (uint64_t id : sample.first) WriteVarint(location_ids_packed, id);
+
+			WriteVarint(values_packed, llround(sample.second.first));
+			WriteVarint(values_packed, llround(sample.second.second));
+
+			std::string sample_msg;
+
+			WriteBytesField(sample_msg, 1, location_ids_packed);
+			WriteBytesField(sample_msg, 2, values_packed);
+
+			WriteBytesField(profile, 2, sample_msg);
+		}
+
+		for (std::string& str : strings) WriteBytesField(profile, 6, str); // string_table, interned strings are all known by now
+
+		out.write(profile.data(), profile.size());
+	}
+}
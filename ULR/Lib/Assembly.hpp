@@ -10,6 +10,7 @@
 #include <functional>
 #include <unordered_map>
 #include <iostream>
+#include <atomic>
 
 #pragma once
 
@@ -78,6 +79,8 @@ namespace ULR
 
 	class Type;
 	class Assembly;
+	class MethodInfo;
+	struct Activator;
 
 	class MemberInfo
 	{
@@ -92,6 +95,22 @@ namespace ULR
 			virtual ~MemberInfo();
 	};
 
+	struct MemberTableEntry
+	{
+		std::string_view name;
+		MemberInfo* member;
+		bool is_static; // the member came from static_attrs (ctors and dtors live there too)
+		unsigned int depth; // number of immediate_base hops between the type owning the table and the declaring type
+		size_t field_offset; // for instance fields, the offset from the start of the object with the struct header already applied
+	};
+
+	struct MethodLookupEntry
+	{
+		int bindingflags;
+		bool non_new;
+		MethodInfo* method;
+	};
+
 	class Type
 	{
 		public:
@@ -114,10 +133,22 @@ namespace ULR
 			Type* element_type; // if the type is an array type
 			size_t element_storage_size;
 
-			void** primary_vtable; // populate this at the end of loading using reflection
-			size_t primary_vtable_len;
+			void** primary_vtable = nullptr; // populate this at the end of loading using reflection
+			size_t primary_vtable_len = 0;
 			std::unordered_map<Type*, void**> interface_vtable;
 
+			std::unordered_multimap<size_t, MethodLookupEntry> method_lookup_cache; // resolved GetMethod/GetNonNewMethod results (inherited ones included), keyed by the hash of the name, signature and binding flags
+
+			std::vector<MemberTableEntry> member_table; // own and inherited members sorted by name, then depth, instance members before static ones
+			bool sealed = false; // member_table has been built (this is unrelated to Modifiers::Sealed)
+
+			// offsets of every reference held by an instance (from the start of the object, type ptr included), fields of nested structs included
+			// for array types, the offsets of the references within one element instead
+			std::vector<size_t> gc_ptr_offsets;
+			std::atomic<bool> gc_map_built { false }; // GC workers build missing maps lazily (under a lock)
+
+			std::atomic<Activator*> activator { nullptr }; // built on the first CreateInstance, see Activator.hpp
+
 			Type(
 				TypeType decl_type,
 				Assembly* assembly,
@@ -144,6 +175,14 @@ namespace ULR
 			void AddStaticMember(MemberInfo* member);
 			void AddInstanceMember(MemberInfo* member);
 
+			// builds member_table; must only be called once all of the type's members (and its base's members) are final
+			bool Seal();
+			std::pair<const MemberTableEntry*, const MemberTableEntry*> FindMembers(std::string_view name);
+			void CollectMembers(std::string_view name, unsigned int depth, std::vector<MemberTableEntry>& out);
+
+			// builds gc_ptr_offsets from the field layout of the type, its bases and the structs it embeds
+			void BuildGCMap();
+
 			// assumes that the call is valid (`type_args` has the right number of args, `this` is a generic type)
 			Type* MakeGeneric(std::vector<Type*> type_args);
 			virtual bool IsGenericPlaceholder() { return false; }
@@ -159,6 +198,8 @@ namespace ULR
 			~GenericPlaceholder();
 	};
 
+	bool IsFloatingPointType(Type* typeptr); // [System]Float or [System]Double, which are passed in vector registers
+
 	class MethodInfo : public MemberInfo
 	{
 		public:
@@ -166,10 +207,16 @@ namespace ULR
 			void* offset;
 			char* generic_llir;
 			Type* rettype;
+			void* invoke_stub = nullptr; // generated on the first Invoke, see InvokeStubs.hpp
+			void* invoke_unboxed_stub = nullptr;
+			int vtable_slot = -1; // for virtual methods, the index into the primary vtable of the declaring type (and of every type deriving from it)
 			MethodInfo(char* name, bool is_static, std::vector<Type*> argsig, Type* rettype, void* offset, int attrs, bool is_generic, char* generic_llir = nullptr);
 			~MethodInfo();
 
 			char* Invoke(char* self, std::vector<char*> args);
+
+			// args point to the arg values (the variable itself for refs), the return value is written to ret, nothing is allocated. self is a ptr to the data for struct methods
+			void InvokeUnboxed(char* self, void* const* args, void* ret);
 	};
 
 	class ConstructorInfo : public MemberInfo
@@ -179,11 +226,14 @@ namespace ULR
 			void* offset;
 			bool is_static = true;
 			char* generic_llir;
+			void* invoke_stub = nullptr; // generated on the first Invoke, see InvokeStubs.hpp
+			void* invoke_unboxed_stub = nullptr;
 			
 			ConstructorInfo(std::vector<Type*> signature, void* offset, int attrs, bool is_generic, char* generic_llir = nullptr);
 
 			// in the high-level API [System.Reflection]ConstructorInfo.Invoke() should return an object, here, the empty object must be passed to it as the first arg  (and the method's return value is ignored by Invoke())
 			void Invoke(char* self, std::vector<char*> args);
+			void InvokeUnboxed(char* self, void* const* args); // see MethodInfo::InvokeUnboxed
 	};
 
 	
@@ -200,17 +250,63 @@ namespace ULR
 			void Invoke(void* obj);
 	};
 
+	enum class FieldKind : unsigned char
+	{
+		Ref, // a ptr to an object
+		Value // a struct stored inline
+	};
+
 	class FieldInfo : public MemberInfo
 	{
+		void WriteBarrier(char* self);
+
 		public:
 			void* offset;
 			Type* valtype;
+
+			// resolved by Compile(), so accesses don't look at the types again
+			FieldKind kind = FieldKind::Ref;
+			size_t data_offset = 0; // from the start of the object, with the struct header applied (instance fields)
+			size_t data_size = sizeof(char*);
+			bool has_refs = true; // writes need a write barrier
 			
 			FieldInfo(char* name, bool is_static, void* offset, Type* valtype, int attrs, bool is_generic);
 			~FieldInfo();
+
+			// must be called once offset and valtype are final (done when the declaring type is sealed, and on lookups in unsealed types)
+			void Compile();
 			
 			char* GetValue(char* self);
 			void SetValue(char* self, char* value);
+
+			// self is ignored for static fields, and is the boxed object (not its data) for struct instance fields
+			inline char* AddressOf(char* self)
+			{
+				return is_static ? (char*) offset : self+data_offset;
+			}
+
+			// sizeof(T) must be data_size, use char* for ref fields
+			template <typename T>
+			inline T Read(char* self)
+			{
+				T value;
+
+				memcpy(&value, AddressOf(self), sizeof(T));
+
+				return value;
+			}
+
+			template <typename T>
+			inline void Write(char* self, T value)
+			{
+				memcpy(AddressOf(self), &value, sizeof(T));
+
+				if (has_refs) WriteBarrier(self);
+			}
+
+			// copy data_size bytes out of/into the field
+			void CopyTo(char* self, void* dest);
+			void CopyFrom(char* self, const void* src);
 	};
 
 	class PropertyInfo : public MemberInfo
@@ -226,6 +322,9 @@ namespace ULR
 			char* GetValue(char* inst);
 			void SetValue(char* inst, char* value);
 
+			// through MethodInfo::InvokeUnboxed, ret/value point to valtype-sized storage
+			void GetValueUnboxed(char* inst, void* ret);
+			void SetValueUnboxed(char* inst, void* value);
 	};
 
 	class Assembly
@@ -267,8 +366,3 @@ inline bool NeedsCallAllocatedSpace(ULR::Type* type)
 {
 	return IsBoxableStruct(type) && !IsFriendlyStructSizex64(type);
 }
-
-inline bool IsFloatingPointType(ULR::Type* type)
-{
-	return (type->name == "[System]Float32") || (type->name == "[System]Float64");
-}
\ No newline at end of file
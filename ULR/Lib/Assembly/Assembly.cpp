@@ -1,4 +1,5 @@
 #include "../Assembly.hpp"
+#include "../UIL.hpp"
 
 namespace ULR
 {
@@ -21,6 +22,8 @@ namespace ULR
 		free(name);
 		free(path);
 		FreeLibrary(handle);
+
+		delete jit_info;
 		
 		for (auto &entry : types)
 		{
@@ -20,32 +20,46 @@ namespace ULR
 		free(name);
 	}
 
-	// assume that the arg types are valid
-	char* FieldInfo::GetValue(char* self)
+	void FieldInfo::Compile()
 	{
-		size_t add_offset = 0;
+		if (!valtype || is_empty_generic) return; // generic fields have no storage of their own
+
+		kind = IsBoxableStruct(valtype) ? FieldKind::Value : FieldKind::Ref;
+		data_size = (kind == FieldKind::Value) ? valtype->size : sizeof(char*);
+
+		has_refs = (kind == FieldKind::Ref) || !valtype->gc_map_built || !valtype->gc_ptr_offsets.empty(); // a struct whose map isn't built yet may hold refs
 
 		// note we add a sizeof(Type*) offset here because the struct offset numbers don't take the vtable pointer into account; we must add it here to get the correct offset
-		if (parent_type->decl_type == TypeType::Struct) add_offset = sizeof(Type*);
+		if (!is_static) data_offset = ((size_t) offset)+((parent_type->decl_type == TypeType::Struct) ? sizeof(Type*) : 0);
+	}
 
-		if (valtype->decl_type != TypeType::Struct)
-		{
-			if (is_static) return *((char**) offset);
-		
-			return *(char**) (((char*) self)+add_offset+((size_t) offset));
-		}
+	void FieldInfo::WriteBarrier(char* self)
+	{
+		if (!is_static) internal_api->heap.WriteBarrier(self); // statics are roots
+	}
+
+	void FieldInfo::CopyTo(char* self, void* dest)
+	{
+		memcpy(dest, AddressOf(self), data_size);
+	}
 
-		void* objstart;
-		size_t objsize = valtype->size;
+	void FieldInfo::CopyFrom(char* self, const void* src)
+	{
+		memcpy(AddressOf(self), src, data_size);
+
+		if (has_refs) WriteBarrier(self);
+	}
 
-		if (is_static) objstart = offset;
-		else objstart = ((char*) self)+add_offset+((size_t) offset);
+	// assume that the arg types are valid
+	char* FieldInfo::GetValue(char* self)
+	{
+		if (kind == FieldKind::Ref) return Read<char*>(self);
 
-		Type** boxed = (Type**) internal_api->AllocateObject(sizeof(Type*)+objsize);
+		Type** boxed = (Type**) internal_api->AllocateObject(sizeof(Type*)+data_size);
 		
 		boxed[0] = valtype;
 
-		memcpy(boxed+1, objstart, objsize);
+		CopyTo(self, boxed+1);
 
 		return (char*) boxed;
 	}
@@ -53,28 +67,7 @@ namespace ULR
 	// as always, we assume that the types are correct
 	void FieldInfo::SetValue(char* self, char* value)
 	{
-		if (valtype->decl_type != TypeType::Struct)
-		{
-			if (is_static)
-			{
-				*(void**) offset = value;
-				return;
-			}
-		
-			void** real_offset = (void**) (((char*) self)+((size_t) offset));
-
-			*real_offset = value;
-			
-			return;
-		}
-
-
-		if (is_static)
-		{
-			memcpy(offset, ((char*) value)+sizeof(Type*), valtype->size);
-			return;
-		}
-
-		memcpy(((char*) self)+((size_t) offset), ((char*) value)+sizeof(Type*), valtype->size);
+		if (kind == FieldKind::Ref) Write<char*>(self, value);
+		else CopyFrom(self, value+sizeof(Type*));
 	}
-}
\ No newline at end of file
+}
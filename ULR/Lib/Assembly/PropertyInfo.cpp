@@ -33,4 +33,16 @@ namespace ULR
 	{
 		this->setter->Invoke(self, { value });
 	}
+
+	void PropertyInfo::GetValueUnboxed(char* self, void* ret)
+	{
+		this->getter->InvokeUnboxed(self, nullptr, ret);
+	}
+
+	void PropertyInfo::SetValueUnboxed(char* self, void* value)
+	{
+		char* discard = nullptr; // setters return [System]Void
+
+		this->setter->InvokeUnboxed(self, &value, &discard);
+	}
 }
\ No newline at end of file
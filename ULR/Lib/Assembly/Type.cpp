@@ -1,5 +1,6 @@
 #include "../Assembly.hpp"
 #include "../Resolver.hpp"
+#include "../Activator.hpp"
 #include <map>
 #include <iostream>
 
@@ -68,6 +69,163 @@ namespace ULR
 		inst_attrs[member->name].emplace_back(member);
 	}
 
+	static MemberTableEntry MakeTableEntry(MemberInfo* member, bool is_static, unsigned int depth)
+	{
+		size_t field_offset = 0;
+
+		if (member->decl_type == MemberType::Field)
+		{
+			FieldInfo* field = (FieldInfo*) member;
+
+			field->Compile();
+
+			if (!is_static) field_offset = field->data_offset;
+		}
+
+		return { member->name, member, is_static, depth, field_offset };
+	}
+
+	// a base type from another assembly is only used once it has been sealed, since its assembly may still be read-only (members not parsed yet)
+	bool Type::Seal()
+	{
+		if (sealed) return true;
+
+		std::vector<MemberTableEntry> table;
+
+		if (immediate_base)
+		{
+			if (immediate_base->assembly == assembly) immediate_base->Seal();
+
+			if (!immediate_base->sealed) return false;
+
+			table.reserve(immediate_base->member_table.size());
+
+			for (auto entry : immediate_base->member_table)
+			{
+				entry.depth++;
+
+				table.emplace_back(entry);
+			}
+		}
+
+		for (auto& entry : inst_attrs)
+		{
+			for (auto member : entry.second) table.emplace_back(MakeTableEntry(member, false, 0));
+		}
+
+		for (auto& entry : static_attrs)
+		{
+			for (auto member : entry.second) table.emplace_back(MakeTableEntry(member, true, 0));
+		}
+
+		// stable so that overloads keep their declaration order
+		std::stable_sort(table.begin(), table.end(), [](const MemberTableEntry& a, const MemberTableEntry& b) {
+			if (a.name != b.name) return a.name < b.name;
+			if (a.depth != b.depth) return a.depth < b.depth;
+
+			return !a.is_static && b.is_static;
+		});
+
+		member_table = std::move(table);
+		sealed = true;
+
+		// array types are sealed as soon as they are created, possibly while their element type is still being compiled, so their map is built on first use
+		if (decl_type != TypeType::ArrayType) BuildGCMap();
+
+		return true;
+	}
+
+	std::pair<const MemberTableEntry*, const MemberTableEntry*> Type::FindMembers(std::string_view name)
+	{
+		const MemberTableEntry* begin = member_table.data();
+		const MemberTableEntry* end = begin+member_table.size();
+
+		const MemberTableEntry* first = std::lower_bound(begin, end, name, [](const MemberTableEntry& entry, std::string_view name) {
+			return entry.name < name;
+		});
+
+		const MemberTableEntry* last = first;
+
+		while (last != end && last->name == name) last++;
+
+		return { first, last };
+	}
+
+	// appends the entries that member_table would hold for `name`, in the same order, by walking the hierarchy (for types that are not sealed yet)
+	void Type::CollectMembers(std::string_view name, unsigned int depth, std::vector<MemberTableEntry>& out)
+	{
+		auto found = inst_attrs.find(name);
+
+		if (found != inst_attrs.end())
+		{
+			for (auto member : found->second) out.emplace_back(MakeTableEntry(member, false, depth));
+		}
+
+		found = static_attrs.find(name);
+
+		if (found != static_attrs.end())
+		{
+			for (auto member : found->second) out.emplace_back(MakeTableEntry(member, true, depth));
+		}
+
+		if (immediate_base) immediate_base->CollectMembers(name, depth+1, out);
+	}
+
+	void Type::BuildGCMap()
+	{
+		if (gc_map_built) return;
+
+		std::vector<size_t> offsets;
+
+		if (decl_type == TypeType::ArrayType)
+		{
+			if (IsBoxableStruct(element_type))
+			{
+				element_type->BuildGCMap();
+
+				// elements are stored without a type ptr
+				for (size_t offset : element_type->gc_ptr_offsets) offsets.push_back(offset-sizeof(Type*));
+			}
+			else offsets.push_back(0);
+		}
+		else if (!is_empty_generic) // empty generics are never instantiated
+		{
+			for (Type* type = this; type; type = type->immediate_base)
+			{
+				// struct field offsets don't take the type ptr of the boxed struct into account (see FieldInfo::Compile)
+				size_t add_offset = (type->decl_type == TypeType::Struct) ? sizeof(Type*) : 0;
+
+				for (auto& entry : type->inst_attrs)
+				{
+					for (auto member : entry.second)
+					{
+						if (member->decl_type != MemberType::Field) continue;
+
+						FieldInfo* field = (FieldInfo*) member;
+
+						size_t field_offset = add_offset+((size_t) field->offset);
+
+						if (!IsBoxableStruct(field->valtype))
+						{
+							offsets.push_back(field_offset);
+							continue;
+						}
+
+						// the struct is stored inline, so its references are ours too
+						field->valtype->BuildGCMap();
+
+						for (size_t offset : field->valtype->gc_ptr_offsets) offsets.push_back(field_offset+offset-sizeof(Type*));
+					}
+				}
+			}
+		}
+
+		std::sort(offsets.begin(), offsets.end());
+
+		gc_ptr_offsets = std::move(offsets);
+		gc_map_built = true;
+	}
+
 	void replace(std::string& str, const std::string& target, const std::string& replacement) {
 		size_t pos = 0;
 
@@ -418,6 +576,8 @@ namespace ULR
 		{
 			delete[] entry.second;
 		}
+
+		delete activator.load();
 	}
 
 	bool IsFloatingPointType(Type* typeptr)
@@ -0,0 +1,52 @@
+#include "Assembly.hpp"
+#include "GCHandles.hpp"
+
+#pragma once
+
+namespace ULR
+{
+	/*
+		A callable made from a MethodInfo (see ULRAPIImpl::CreateDelegate), called with native arg passing.
+		Closed delegates are bound to a receiver, whose virtual target is resolved once at bind time. Open delegates
+		take the receiver as the first arg of each call and dispatch on it through its primary vtable.
+	*/
+	struct Delegate
+	{
+		MethodInfo* method;
+		void* target; // the code to call, for open virtual delegates the declared method's code
+		char* receiver = nullptr; // closed delegates, already adjusted to the data for struct receivers
+		Heap::GCHandle receiver_handle = nullptr; // keeps the receiver alive (pinned, since `receiver` may be an interior ptr)
+		bool is_open = false;
+		bool is_virtual = false;
+		size_t this_offset = 0; // struct methods take a ptr to the data, skip the type ptr
+
+		void* ResolveTarget(Type* type) const; // for types without a primary vtable entry for the method
+
+		inline void* TargetFor(char* self) const
+		{
+			if (!is_virtual) return target;
+
+			Type* type = *(Type**) self;
+
+			if (type->primary_vtable && (size_t) method->vtable_slot < type->primary_vtable_len) return type->primary_vtable[method->vtable_slot];
+
+			return ResolveTarget(type);
+		}
+
+		// static and closed delegates
+		template <typename Ret, typename... Args>
+		inline Ret Invoke(Args... args) const
+		{
+			if (receiver) return ((Ret (*)(char*, Args...)) target)(receiver, args...);
+
+			return ((Ret (*)(Args...)) target)(args...);
+		}
+
+		// open delegates, self is the receiver (boxed, for structs)
+		template <typename Ret, typename... Args>
+		inline Ret InvokeOpen(char* self, Args... args) const
+		{
+			return ((Ret (*)(char*, Args...)) TargetFor(self))(self+this_offset, args...);
+		}
+	};
+}
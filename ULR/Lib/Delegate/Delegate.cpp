@@ -0,0 +1,12 @@
+#include "../Delegate.hpp"
+#include "../Resolver.hpp"
+
+namespace ULR
+{
+	void* Delegate::ResolveTarget(Type* type) const
+	{
+		MethodInfo* impl = internal_api->GetNonNewMethod(type, method->name, method->argsig, Resolver::BindingFlags::Public | Resolver::BindingFlags::NonPublic | Resolver::BindingFlags::Instance);
+
+		return impl ? impl->offset : target;
+	}
+}
@@ -0,0 +1,64 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+#pragma once
+
+namespace ULR::Heap
+{
+	enum class GCHandleType : unsigned char
+	{
+		Free,
+		Weak, // doesn't keep its target alive, cleared when the target is found dead (before finalization)
+		Strong, // a root, for native code that keeps objects where the GC doesn't scan
+		Pinned // a root whose target must not move, objects never move in this heap so it is only a promise to native code holding interior ptrs
+	};
+
+	struct GCHandleSlot
+	{
+		std::atomic<char*> obj { nullptr };
+		std::atomic<GCHandleType> type { GCHandleType::Free };
+		GCHandleSlot* next_free = nullptr;
+	};
+
+	typedef GCHandleSlot* GCHandle;
+
+	constexpr size_t HANDLE_BLOCK_SIZE = 1024; // slots per block, blocks are never freed so handles stay valid
+	constexpr size_t MAX_HANDLE_BLOCKS = 4096;
+
+	/*
+		Collections read the table without taking its lock (a stopped thread may hold it), so blocks are only ever appended
+		and a slot's target is published before its type. Handles must only be used by registered threads outside of EnterNative.
+	*/
+	class GCHandleTable
+	{
+		GCHandleSlot* blocks[MAX_HANDLE_BLOCKS];
+		std::atomic<size_t> num_blocks { 0 };
+		GCHandleSlot* free_list = nullptr;
+		std::mutex lock;
+
+		public:
+			std::atomic<size_t> num_handles { 0 };
+
+			~GCHandleTable();
+
+			GCHandle Alloc(char* obj, GCHandleType type); // returns nullptr if the table is full
+			void Free(GCHandle handle);
+
+			inline char* Get(GCHandle handle)
+			{
+				return handle->obj.load(std::memory_order_acquire);
+			}
+
+			inline void Set(GCHandle handle, char* obj)
+			{
+				handle->obj.store(obj, std::memory_order_release);
+			}
+
+			// only while the world is stopped
+			void ForEachStrong(const std::function<void(char*)>& visit); // strong and pinned targets
+			size_t ClearDeadWeak(const std::function<bool(char*)>& is_live); // returns the number of handles cleared
+	};
+}
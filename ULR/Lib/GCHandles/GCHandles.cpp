@@ -0,0 +1,98 @@
+#include "../GCHandles.hpp"
+
+namespace ULR::Heap
+{
+	GCHandleTable::~GCHandleTable()
+	{
+		for (size_t i = 0; i < num_blocks; i++) delete[] blocks[i];
+	}
+
+	GCHandle GCHandleTable::Alloc(char* obj, GCHandleType type)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+
+		if (!free_list)
+		{
+			size_t index = num_blocks.load(std::memory_order_relaxed);
+
+			if (index == MAX_HANDLE_BLOCKS) return nullptr;
+
+			GCHandleSlot* block = new GCHandleSlot[HANDLE_BLOCK_SIZE];
+
+			for (size_t i = HANDLE_BLOCK_SIZE; i > 0; i--)
+			{
+				block[i-1].next_free = free_list;
+				free_list = &block[i-1];
+			}
+
+			blocks[index] = block;
+			num_blocks.store(index+1, std::memory_order_release);
+		}
+
+		GCHandle handle = free_list;
+
+		free_list = handle->next_free;
+
+		handle->obj.store(obj, std::memory_order_relaxed);
+		handle->type.store(type, std::memory_order_release);
+
+		num_handles++;
+
+		return handle;
+	}
+
+	void GCHandleTable::Free(GCHandle handle)
+	{
+		if (!handle) return;
+
+		std::lock_guard<std::mutex> guard(lock);
+
+		handle->type.store(GCHandleType::Free, std::memory_order_release);
+		handle->obj.store(nullptr, std::memory_order_relaxed);
+
+		handle->next_free = free_list;
+		free_list = handle;
+
+		num_handles--;
+	}
+
+	void GCHandleTable::ForEachStrong(const std::function<void(char*)>& visit)
+	{
+		size_t count = num_blocks.load(std::memory_order_acquire);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			for (GCHandleSlot* slot = blocks[i]; slot < blocks[i]+HANDLE_BLOCK_SIZE; slot++)
+			{
+				GCHandleType type = slot->type.load(std::memory_order_acquire);
+
+				if (type != GCHandleType::Strong && type != GCHandleType::Pinned) continue;
+
+				if (char* obj = slot->obj.load(std::memory_order_relaxed)) visit(obj);
+			}
+		}
+	}
+
+	size_t GCHandleTable::ClearDeadWeak(const std::function<bool(char*)>& is_live)
+	{
+		size_t count = num_blocks.load(std::memory_order_acquire);
+		size_t num_cleared = 0;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			for (GCHandleSlot* slot = blocks[i]; slot < blocks[i]+HANDLE_BLOCK_SIZE; slot++)
+			{
+				if (slot->type.load(std::memory_order_acquire) != GCHandleType::Weak) continue;
+
+				char* obj = slot->obj.load(std::memory_order_relaxed);
+
+				if (!obj || is_live(obj)) continue;
+
+				slot->obj.store(nullptr, std::memory_order_relaxed);
+				num_cleared++;
+			}
+		}
+
+		return num_cleared;
+	}
+}
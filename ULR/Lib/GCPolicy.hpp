@@ -0,0 +1,81 @@
+#include <atomic>
+#include <cstddef>
+
+#pragma once
+
+namespace ULR::Heap
+{
+	enum class GCMode
+	{
+		Throughput, // few, large collections
+		Latency // short pauses: the nursery (if enabled) is resized to meet a pause target and the heap grows less between full collections
+	};
+
+	enum class GCKind
+	{
+		None,
+		Nursery,
+		Full
+	};
+
+	// read from the ULR_GC_* environment variables (which ulrhost's --gc-* options set), see ReadGCConfig
+	struct GCConfig
+	{
+		GCMode mode = GCMode::Throughput;
+		double growth_factor = 2.0; // a full collection is triggered once the heap reaches live size * growth_factor
+		size_t min_heap_size = 64000000; // no full collections below this
+		size_t heap_limit = 0; // hard limit on the heap size, 0 means none
+		size_t nursery_size = 0; // bytes allocated between nursery collections (the upper bound in latency mode), 0 disables them since they rely on every native reference store having a ULR_WRITE_BARRIER
+		size_t pause_target_us = 1000; // latency mode only
+		unsigned int workers = 0; // parallel marking threads, 0 means one per core
+	};
+
+	GCConfig ReadGCConfig();
+
+	// decides when to collect; a collection reports back through OnCollection, which sets the next triggers
+	class GCPolicy
+	{
+		protected:
+			std::atomic<size_t> full_trigger; // heap size
+			std::atomic<size_t> nursery_trigger; // young size, never reached while nursery collections are disabled
+
+		public:
+			GCConfig config;
+
+			// statistics
+			size_t num_full = 0;
+			size_t num_nursery = 0;
+			size_t peak_heap_size = 0; // largest heap size a collection started with
+			size_t max_pause_us = 0;
+
+			GCPolicy(const GCConfig& config);
+			virtual ~GCPolicy() = default;
+
+			// called before every allocation of `size` bytes
+			inline GCKind OnAllocation(size_t heap_size, size_t young_size, size_t size)
+			{
+				if (heap_size+size > full_trigger.load(std::memory_order_relaxed)) return GCKind::Full;
+				if (young_size+size > nursery_trigger.load(std::memory_order_relaxed)) return GCKind::Nursery;
+
+				return GCKind::None;
+			}
+
+			// whether the heap would pass the hard limit
+			inline bool ExceedsLimit(size_t heap_size, size_t size)
+			{
+				return config.heap_limit && (heap_size+size > config.heap_limit);
+			}
+
+			virtual void OnCollection(bool nursery, size_t heap_size_before, size_t live_size, size_t pause_us);
+	};
+
+	class LatencyGCPolicy : public GCPolicy
+	{
+		public:
+			LatencyGCPolicy(const GCConfig& config);
+
+			void OnCollection(bool nursery, size_t heap_size_before, size_t live_size, size_t pause_us) override;
+	};
+
+	GCPolicy* CreateGCPolicy(const GCConfig& config);
+}
@@ -0,0 +1,124 @@
+#include "../GCPolicy.hpp"
+#include <Windows.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+const size_t MIN_NURSERY_SIZE = 1000000;
+const double LATENCY_MAX_GROWTH_FACTOR = 1.5;
+
+namespace ULR::Heap
+{
+	// GetEnvironmentVariableA instead of getenv, since ulrhost's managed launcher sets the variables after the CRT has copied the environment
+	static bool ReadEnv(const char* name, char* buffer, DWORD buffer_size)
+	{
+		DWORD len = GetEnvironmentVariableA(name, buffer, buffer_size);
+
+		return len && (len < buffer_size);
+	}
+
+	// accepts a k, m or g suffix (decimal, like the _mb literals)
+	static size_t ParseSize(const char* str)
+	{
+		char* end;
+
+		size_t size = strtoull(str, &end, 10);
+
+		switch (*end)
+		{
+			case 'k':
+			case 'K':
+				return size*1000;
+			case 'm':
+			case 'M':
+				return size*1000000;
+			case 'g':
+			case 'G':
+				return size*1000000000;
+		}
+
+		return size;
+	}
+
+	GCConfig ReadGCConfig()
+	{
+		GCConfig config;
+
+		char value[64];
+
+		if (ReadEnv("ULR_GC_MODE", value, sizeof(value)))
+		{
+			if (strcmp(value, "latency") == 0) config.mode = GCMode::Latency;
+			else if (strcmp(value, "throughput") == 0) config.mode = GCMode::Throughput;
+		}
+
+		if (ReadEnv("ULR_GC_GROWTH", value, sizeof(value))) config.growth_factor = std::max(strtod(value, nullptr), 1.0);
+		if (ReadEnv("ULR_GC_MIN_HEAP", value, sizeof(value))) config.min_heap_size = ParseSize(value);
+		if (ReadEnv("ULR_GC_HEAP_LIMIT", value, sizeof(value))) config.heap_limit = ParseSize(value);
+		if (ReadEnv("ULR_GC_NURSERY", value, sizeof(value)))
+		{
+			size_t nursery_size = ParseSize(value);
+
+			config.nursery_size = nursery_size ? std::max(nursery_size, MIN_NURSERY_SIZE) : 0; // opt-in, see GCConfig::nursery_size
+		}
+		if (ReadEnv("ULR_GC_PAUSE_TARGET_US", value, sizeof(value))) config.pause_target_us = ParseSize(value);
+		if (ReadEnv("ULR_GC_WORKERS", value, sizeof(value))) config.workers = (unsigned int) strtoul(value, nullptr, 10);
+
+		if (config.heap_limit) config.min_heap_size = std::min(config.min_heap_size, config.heap_limit);
+
+		return config;
+	}
+
+	GCPolicy::GCPolicy(const GCConfig& config)
+	{
+		this->config = config;
+		this->full_trigger = config.min_heap_size;
+		this->nursery_trigger = config.nursery_size ? config.nursery_size : SIZE_MAX;
+	}
+
+	void GCPolicy::OnCollection(bool nursery, size_t heap_size_before, size_t live_size, size_t pause_us)
+	{
+		if (nursery) num_nursery++;
+		else num_full++;
+
+		peak_heap_size = std::max(peak_heap_size, heap_size_before);
+		max_pause_us = std::max(max_pause_us, pause_us);
+
+		if (nursery) return; // old objects aren't traced by nursery collections, so live_size includes the dead ones
+
+		size_t trigger = std::max((size_t) (live_size*config.growth_factor), config.min_heap_size);
+
+		// approaching the limit, collect more often rather than failing allocations
+		if (config.heap_limit) trigger = std::min(trigger, live_size+((config.heap_limit-std::min(live_size, config.heap_limit))/2));
+
+		full_trigger = trigger;
+	}
+
+	LatencyGCPolicy::LatencyGCPolicy(const GCConfig& config) : GCPolicy(config)
+	{
+		this->config.growth_factor = std::min(config.growth_factor, LATENCY_MAX_GROWTH_FACTOR);
+	}
+
+	void LatencyGCPolicy::OnCollection(bool nursery, size_t heap_size_before, size_t live_size, size_t pause_us)
+	{
+		GCPolicy::OnCollection(nursery, heap_size_before, live_size, pause_us);
+
+		if (!nursery || !config.nursery_size) return; // explicit nursery collections don't enable the automatic ones
+
+		// nursery pauses scale with the survivors, which scale with the nursery size
+		size_t nursery_size = nursery_trigger;
+
+		if (pause_us > config.pause_target_us) nursery_size/=2;
+		else if (pause_us < config.pause_target_us/2) nursery_size*=2;
+
+		nursery_trigger = std::clamp(nursery_size, MIN_NURSERY_SIZE, config.nursery_size);
+	}
+
+	GCPolicy* CreateGCPolicy(const GCConfig& config)
+	{
+		if (config.mode == GCMode::Latency) return new LatencyGCPolicy(config);
+
+		return new GCPolicy(config);
+	}
+}
@@ -0,0 +1,97 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#pragma once
+
+namespace ULR::Heap
+{
+	// one collection, times are steady_clock nanoseconds/microseconds
+	struct GCEvent
+	{
+		uint64_t id; // collections are numbered from 1
+		bool nursery;
+		int64_t start_ns;
+		int64_t end_ns;
+
+		// phases of the pause
+		uint64_t stop_us; // until every thread reached a safepoint (or was suspended)
+		uint64_t mark_us;
+		uint64_t finalize_us; // finding dead finalizable objects and marking what they reference
+		uint64_t sweep_us; // counting only, segments are swept lazily afterwards
+		uint64_t pause_us;
+
+		size_t heap_size_before;
+		size_t heap_size_after;
+		size_t young_size_before;
+		size_t promoted_size; // young bytes that survived (nursery collections)
+
+		size_t num_collected;
+		size_t size_collected;
+		size_t stack_slots_scanned;
+		size_t static_roots_scanned;
+		size_t num_handles;
+		size_t num_weak_handles_cleared;
+		size_t num_queued_for_finalization;
+		size_t num_finalized; // dtors run by the finalizer thread since the previous collection
+
+		unsigned int num_threads; // registered threads
+		unsigned int num_workers; // marking threads
+	};
+
+	constexpr size_t GC_EVENT_CAPACITY = 256; // most recent collections kept
+
+	/*
+		log-linear histogram of pause times (in microseconds), in the style of HdrHistogram:
+		every power of two is split into 2^HISTOGRAM_SUB_BITS buckets, so values are recorded with a relative error below 1/2^HISTOGRAM_SUB_BITS
+	*/
+	constexpr size_t HISTOGRAM_SUB_BITS = 4;
+	constexpr size_t HISTOGRAM_SUB_BUCKETS = 1 << HISTOGRAM_SUB_BITS;
+	constexpr size_t HISTOGRAM_MAX_EXPONENT = 40; // ~12 days
+	constexpr size_t HISTOGRAM_BUCKETS = (HISTOGRAM_MAX_EXPONENT+1)*HISTOGRAM_SUB_BUCKETS;
+
+	class PauseHistogram
+	{
+		std::atomic<uint64_t> buckets[HISTOGRAM_BUCKETS] = { };
+		std::atomic<uint64_t> count { 0 };
+		std::atomic<uint64_t> total { 0 };
+		std::atomic<uint64_t> min { UINT64_MAX };
+		std::atomic<uint64_t> max { 0 };
+
+		static size_t BucketOf(uint64_t value);
+		static uint64_t BucketUpperBound(size_t bucket);
+
+		public:
+			void Record(uint64_t value);
+			void Reset();
+
+			uint64_t Count() { return count; }
+			uint64_t Min() { return count ? min.load() : 0; }
+			uint64_t Max() { return max; }
+			double Mean() { return count ? ((double) total)/count : 0; }
+			// smallest bucket bound at or above the given fraction (0-1) of the recorded values
+			uint64_t Percentile(double fraction);
+	};
+
+	class GCTelemetry
+	{
+		// seqlock ring buffer: the collecting thread is the only writer (collections are serialized), readers retry torn slots
+		struct Slot
+		{
+			std::atomic<uint64_t> seq { 0 }; // odd while being written
+			GCEvent event;
+		};
+
+		Slot events[GC_EVENT_CAPACITY];
+		std::atomic<uint64_t> next_id { 1 };
+
+		public:
+			PauseHistogram nursery_pauses;
+			PauseHistogram full_pauses;
+
+			void Record(GCEvent& event); // assigns event.id
+			uint64_t LastEventId() { return next_id-1; }
+			// copies up to max_events of the most recent events (oldest first), returns the number copied
+			size_t GetRecentEvents(GCEvent* out, size_t max_events);
+	};
+}
@@ -0,0 +1,126 @@
+#include "../GCTelemetry.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace ULR::Heap
+{
+	size_t PauseHistogram::BucketOf(uint64_t value)
+	{
+		if (value < HISTOGRAM_SUB_BUCKETS) return value; // exact below the first split
+
+		size_t exponent = 63-__builtin_clzll(value); // value is in [2^exponent, 2^(exponent+1))
+		size_t sub_bucket = (value >> (exponent-HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_BUCKETS-1);
+
+		size_t bucket = ((exponent-HISTOGRAM_SUB_BITS+1)*HISTOGRAM_SUB_BUCKETS)+sub_bucket;
+
+		return std::min(bucket, HISTOGRAM_BUCKETS-1);
+	}
+
+	uint64_t PauseHistogram::BucketUpperBound(size_t bucket)
+	{
+		if (bucket < HISTOGRAM_SUB_BUCKETS) return bucket;
+
+		size_t exponent = (bucket/HISTOGRAM_SUB_BUCKETS)+HISTOGRAM_SUB_BITS-1;
+		size_t sub_bucket = bucket % HISTOGRAM_SUB_BUCKETS;
+
+		uint64_t width = ((uint64_t) 1) << (exponent-HISTOGRAM_SUB_BITS);
+
+		return (((uint64_t) 1) << exponent)+((sub_bucket+1)*width)-1;
+	}
+
+	void PauseHistogram::Record(uint64_t value)
+	{
+		buckets[BucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+
+		count.fetch_add(1, std::memory_order_relaxed);
+		total.fetch_add(value, std::memory_order_relaxed);
+
+		uint64_t prev = min.load(std::memory_order_relaxed);
+
+		while (value < prev && !min.compare_exchange_weak(prev, value, std::memory_order_relaxed));
+
+		prev = max.load(std::memory_order_relaxed);
+
+		while (value > prev && !max.compare_exchange_weak(prev, value, std::memory_order_relaxed));
+	}
+
+	void PauseHistogram::Reset()
+	{
+		for (auto& bucket : buckets) bucket.store(0, std::memory_order_relaxed);
+
+		count = 0;
+		total = 0;
+		min = UINT64_MAX;
+		max = 0;
+	}
+
+	uint64_t PauseHistogram::Percentile(double fraction)
+	{
+		uint64_t num_values = count;
+
+		if (!num_values) return 0;
+
+		uint64_t rank = (uint64_t) (fraction*num_values);
+
+		if (rank >= num_values) rank = num_values-1;
+
+		uint64_t seen = 0;
+
+		for (size_t bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++)
+		{
+			seen+=buckets[bucket].load(std::memory_order_relaxed);
+
+			if (seen > rank) return std::min(BucketUpperBound(bucket), max.load());
+		}
+
+		return max;
+	}
+
+	void GCTelemetry::Record(GCEvent& event)
+	{
+		event.id = next_id.load(std::memory_order_relaxed);
+
+		Slot& slot = events[event.id % GC_EVENT_CAPACITY];
+
+		uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+
+		slot.seq.store(seq+1, std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_release);
+
+		memcpy(&slot.event, &event, sizeof(GCEvent));
+
+		slot.seq.store(seq+2, std::memory_order_release);
+
+		next_id.store(event.id+1, std::memory_order_release);
+
+		(event.nursery ? nursery_pauses : full_pauses).Record(event.pause_us);
+	}
+
+	size_t GCTelemetry::GetRecentEvents(GCEvent* out, size_t max_events)
+	{
+		uint64_t last = next_id.load(std::memory_order_acquire)-1;
+		uint64_t num = std::min({ (uint64_t) max_events, (uint64_t) GC_EVENT_CAPACITY, last });
+
+		size_t copied = 0;
+
+		for (uint64_t id = last-num+1; id <= last; id++)
+		{
+			Slot& slot = events[id % GC_EVENT_CAPACITY];
+
+			uint64_t seq_before = slot.seq.load(std::memory_order_acquire);
+
+			if (seq_before & 1) continue; // being overwritten by a newer collection
+
+			memcpy(&out[copied], &slot.event, sizeof(GCEvent));
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			if (slot.seq.load(std::memory_order_relaxed) != seq_before || out[copied].id != id) continue; // torn or already replaced
+
+			copied++;
+		}
+
+		return copied;
+	}
+}
@@ -0,0 +1,263 @@
+#include <Windows.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#pragma once
+
+namespace ULR
+{
+	namespace Heap
+	{
+		constexpr size_t GRANULE = 16; // every object start is aligned to (and every cell size is a multiple of) this
+		constexpr size_t SEGMENT_SHIFT = 18;
+		constexpr size_t SEGMENT_SIZE = 1 << SEGMENT_SHIFT;
+		constexpr size_t CELLS_PER_SEGMENT = SEGMENT_SIZE/GRANULE; // upper bound, used to size the bitmaps
+		constexpr size_t BITMAP_WORDS = CELLS_PER_SEGMENT/64;
+		constexpr size_t HEAP_RESERVE_SIZE = ((size_t) 64) << 30; // address space only, segments are committed as they are needed
+		constexpr size_t MAX_SEGMENTS = HEAP_RESERVE_SIZE/SEGMENT_SIZE;
+		constexpr size_t CARD_SHIFT = 9; // one card table byte per 512 bytes of heap
+		constexpr size_t NUM_CARDS = HEAP_RESERVE_SIZE >> CARD_SHIFT;
+		constexpr unsigned char CARD_DIRTY = 1;
+
+		constexpr size_t SIZE_CLASSES[] = {
+			16, 32, 48, 64, 80, 96, 112, 128,
+			160, 192, 224, 256, 320, 384, 448, 512,
+			640, 768, 896, 1024, 1280, 1536, 1792, 2048,
+			2560, 3072, 3584, 4096, 5120, 6144, 7168, 8192,
+			10240, 12288, 14336, 16384, 20480, 24576, 28672, 32768
+		};
+
+		constexpr size_t NUM_SIZE_CLASSES = sizeof(SIZE_CLASSES)/sizeof(size_t);
+		constexpr size_t MAX_SMALL_OBJECT_SIZE = SIZE_CLASSES[NUM_SIZE_CLASSES-1]; // anything larger goes to the large object space
+		constexpr size_t LARGE_OBJECT_PAGE = 4096; // large objects are rounded up to whole pages
+
+		struct Segment
+		{
+			char* start;
+			size_t cell_size;
+			size_t num_cells;
+			unsigned char size_class;
+			bool owned = false; // an allocation buffer is bumping through it, so it isn't handed out to another thread
+			std::atomic<uint64_t> alloc_bits[BITMAP_WORDS]; // object starts, set lock-free by the owning thread
+			std::atomic<uint64_t> mark_bits[BITMAP_WORDS]; // set concurrently by the GC workers
+		};
+
+		// every large object has its own zeroed pages from VirtualAlloc, which go back to the OS as soon as it is swept
+		// the pages start with its header, so objects keep the usual layout (a type ptr, then the fields) and the GC state sits next to them
+		struct LargeObjectHeader
+		{
+			size_t size; // of the whole region, page rounded
+			std::atomic<bool> marked { false };
+		};
+
+		constexpr size_t LARGE_OBJECT_HEADER_SIZE = GRANULE; // keeps large objects aligned like the small ones
+		static_assert(sizeof(LargeObjectHeader) <= LARGE_OBJECT_HEADER_SIZE);
+
+		inline LargeObjectHeader* LargeHeaderOf(char* obj)
+		{
+			return (LargeObjectHeader*) (obj-LARGE_OBJECT_HEADER_SIZE);
+		}
+
+		constexpr size_t MARK_DEQUE_CAPACITY = 1 << 18; // entries; objects that don't fit are found again by rescanning the marked objects
+
+		// fixed-size Chase-Lev work-stealing deque: the owning GC worker pushes & pops at the bottom, other workers steal from the top
+		class MarkDeque
+		{
+			std::atomic<int64_t> top { 0 };
+			std::atomic<int64_t> bottom { 0 };
+			std::atomic<char*>* buffer;
+
+			public:
+				MarkDeque() { buffer = new std::atomic<char*>[MARK_DEQUE_CAPACITY]; }
+				~MarkDeque() { delete[] buffer; }
+
+				// returns false if the deque is full
+				inline bool Push(char* obj)
+				{
+					int64_t b = bottom.load(std::memory_order_relaxed);
+					int64_t t = top.load(std::memory_order_acquire);
+
+					if ((size_t) (b-t) >= MARK_DEQUE_CAPACITY) return false;
+
+					buffer[b & (MARK_DEQUE_CAPACITY-1)].store(obj, std::memory_order_relaxed);
+
+					std::atomic_thread_fence(std::memory_order_release);
+
+					bottom.store(b+1, std::memory_order_relaxed);
+
+					return true;
+				}
+
+				inline char* Pop()
+				{
+					int64_t b = bottom.load(std::memory_order_relaxed)-1;
+
+					bottom.store(b, std::memory_order_relaxed);
+
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+
+					int64_t t = top.load(std::memory_order_relaxed);
+
+					if (t > b) // empty
+					{
+						bottom.store(b+1, std::memory_order_relaxed);
+
+						return nullptr;
+					}
+
+					char* obj = buffer[b & (MARK_DEQUE_CAPACITY-1)].load(std::memory_order_relaxed);
+
+					if (t == b) // last entry, race the thieves for it
+					{
+						if (!top.compare_exchange_strong(t, t+1, std::memory_order_seq_cst, std::memory_order_relaxed)) obj = nullptr;
+
+						bottom.store(b+1, std::memory_order_relaxed);
+					}
+
+					return obj;
+				}
+
+				// returns nullptr if the deque is empty or another worker won the entry
+				inline char* Steal()
+				{
+					int64_t t = top.load(std::memory_order_acquire);
+
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+
+					int64_t b = bottom.load(std::memory_order_acquire);
+
+					if (t >= b) return nullptr;
+
+					char* obj = buffer[t & (MARK_DEQUE_CAPACITY-1)].load(std::memory_order_relaxed);
+
+					if (!top.compare_exchange_strong(t, t+1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
+
+					return obj;
+				}
+
+				inline bool Empty()
+				{
+					return bottom.load(std::memory_order_acquire) <= top.load(std::memory_order_acquire);
+				}
+		};
+
+		struct AllocationBuffer
+		{
+			char* cursor = nullptr;
+			char* limit = nullptr;
+			size_t next_cell = 0; // cell index of cursor
+			Segment* segment = nullptr;
+		};
+
+		struct SweepStats
+		{
+			size_t num_dead = 0;
+			size_t dead_size = 0;
+		};
+
+		class ManagedHeap;
+
+		struct ThreadAllocationBuffers
+		{
+			ManagedHeap* heap = nullptr;
+			AllocationBuffer classes[NUM_SIZE_CLASSES];
+
+			~ThreadAllocationBuffers();
+		};
+
+		// there is one runtime (and so one heap) per process, since the allocation buffers are thread_local
+		class ManagedHeap
+		{
+			char* commit_end; // segments are carved out of the reservation in order
+			Segment** segment_table; // indexed by (addr-base) >> SEGMENT_SHIFT
+			std::vector<Segment*> segments;
+			std::vector<Segment*> free_segments; // empty, can take any size class
+			std::vector<Segment*> partial_segments[NUM_SIZE_CLASSES]; // have free cells and no owner (rebuilt by every sweep)
+			std::vector<Segment*> unswept_segments; // no owner, dead objects are reclaimed when a segment is taken or by FinishSweep
+			std::vector<ThreadAllocationBuffers*> threads;
+			unsigned char size_class_of[MAX_SMALL_OBJECT_SIZE/GRANULE+1];
+
+			std::vector<char*> large_objs; // the large object space, sorted for interior pointer lookups
+			char* large_objs_begin = nullptr; // bounds of the large object space, so that most non-pointers are never searched for
+			char* large_objs_end = nullptr;
+
+			char* FindLargeObject(char* addr); // the large object addr points into, nullptr if none
+			void UpdateLargeObjectBounds();
+
+			char* AllocateSlow(ThreadAllocationBuffers& buffers, unsigned char size_class);
+			char* AllocateLarge(size_t size);
+			Segment* TakeSegment(unsigned char size_class);
+			size_t SweepSegment(Segment* segment); // returns the number of live cells
+			void SweepNext();
+			bool NextFreeRun(AllocationBuffer& buffer);
+			void ScanMarked(Segment* segment, const std::function<void(char*)>& callback);
+
+			friend struct ThreadAllocationBuffers;
+
+			public:
+				char* base;
+				unsigned char* card_table; // indexed by (addr-base) >> CARD_SHIFT, committed along with the segments it covers
+				std::recursive_mutex heap_lock;
+				std::atomic<size_t> allocated_size { 0 }; // bytes handed out since the last sweep plus the bytes that survived it
+				std::atomic<size_t> young_size { 0 }; // bytes handed out since the last sweep
+
+				ManagedHeap();
+				~ManagedHeap();
+
+				char* Allocate(size_t size);
+				char* AllocateZeroed(size_t size); // large objects are already zeroed by the OS, so only small ones are cleared
+
+				// cheap filter for conservative roots, false means addr can't point into an object
+				inline bool MayPointIntoHeap(char* addr)
+				{
+					return (addr >= base && addr < commit_end) || (addr >= large_objs_begin && addr < large_objs_end);
+				}
+
+				// returns obj if it is the start of an allocated object, nullptr otherwise
+				char* FindObject(char* obj);
+				// returns the start of the allocated object addr points into (interior pointers included), nullptr otherwise
+				char* FindContainingObject(char* addr);
+				// bytes taken by an allocated object (its cell, or the pages of a large object), only while no thread allocates
+				size_t SizeOf(char* obj);
+				// marks obj if it is the start of an allocated object, returns whether it was unmarked before (thread-safe)
+				bool Mark(char* obj);
+				// whether obj is the start of an allocated, marked object
+				bool IsMarked(char* obj);
+				/*
+					Generations use sticky mark bits: a sweep leaves the mark bits of survivors set, so marked objects are old and unmarked ones are young.
+					A full collection clears the marks first, a nursery collection keeps them, so that marking stops at old objects and only young ones can be swept.
+				*/
+				void ClearMarks();
+				void ForEachMarkedObject(const std::function<void(char*)>& callback);
+				// the allocated objects that the next sweep frees, only valid between marking and BeginSweep
+				void ForEachUnmarkedObject(const std::function<void(char*)>& callback);
+				// the old objects that may reference young ones are the objects starting in dirty cards, and all old large objects since they have no cards
+				// segments can be scanned concurrently, scanning a segment cleans its cards
+				size_t NumSegments() { return segments.size(); }
+				void ScanRememberedSegment(size_t index, const std::function<void(char*)>& scan_old);
+				void ScanRememberedLargeObjects(const std::function<void(char*)>& scan_old);
+
+				// must be called with the start of an object after a reference is stored into it
+				inline void WriteBarrier(char* obj)
+				{
+					size_t card = ((size_t) (obj-base)) >> CARD_SHIFT;
+
+					if (card < NUM_CARDS) card_table[card] = CARD_DIRTY; // objects outside of the segments (large objects) don't have cards
+				}
+
+				/*
+					Sweeping is lazy: BeginSweep only counts the dead objects (from the bitmaps) and frees the dead large objects,
+					the segments are swept as allocation takes them, and whatever is left by FinishSweep (before the next collection marks).
+					Survivors stay marked (old).
+				*/
+				SweepStats BeginSweep();
+				void FinishSweep();
+
+				// frees everything, objects aren't destructed
+				void Release();
+		};
+	}
+}
@@ -0,0 +1,611 @@
+#include "../Heap.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace ULR
+{
+	namespace Heap
+	{
+		static thread_local ThreadAllocationBuffers thread_buffers;
+
+		// index of the first cell in [from, end) whose bit equals value, or end
+		static size_t FindBit(const std::atomic<uint64_t>* bits, size_t from, size_t end, bool value)
+		{
+			while (from < end)
+			{
+				uint64_t word = bits[from >> 6].load(std::memory_order_relaxed);
+
+				if (!value) word = ~word;
+
+				word&=~((uint64_t) 0) << (from & 63);
+
+				if (word)
+				{
+					size_t found = (from & ~((size_t) 63))+__builtin_ctzll(word);
+
+					return (found < end) ? found : end;
+				}
+
+				from = (from & ~((size_t) 63))+64;
+			}
+
+			return end;
+		}
+
+		ThreadAllocationBuffers::~ThreadAllocationBuffers()
+		{
+			if (!heap) return; // never allocated or the heap was released first
+
+			std::lock_guard<std::recursive_mutex> lock(heap->heap_lock);
+
+			// the segments are listed again by the next sweep
+			for (auto& buffer : classes)
+			{
+				if (buffer.segment) buffer.segment->owned = false;
+			}
+
+			auto& threads = heap->threads;
+
+			threads.erase(std::find(threads.begin(), threads.end(), this));
+		}
+
+		ManagedHeap::ManagedHeap()
+		{
+			base = (char*) VirtualAlloc(NULL, HEAP_RESERVE_SIZE, MEM_RESERVE, PAGE_READWRITE);
+			commit_end = base;
+			card_table = (unsigned char*) VirtualAlloc(NULL, NUM_CARDS, MEM_RESERVE, PAGE_READWRITE);
+			segment_table = new Segment*[MAX_SEGMENTS]();
+
+			unsigned char size_class = 0;
+
+			for (size_t granules = 0; granules <= MAX_SMALL_OBJECT_SIZE/GRANULE; granules++)
+			{
+				if (granules*GRANULE > SIZE_CLASSES[size_class]) size_class++;
+
+				size_class_of[granules] = size_class;
+			}
+		}
+
+		ManagedHeap::~ManagedHeap()
+		{
+			if (base) Release();
+		}
+
+		Segment* ManagedHeap::TakeSegment(unsigned char size_class)
+		{
+			Segment* segment;
+			bool reassigned = false;
+
+			// reclaim swept segments before committing new ones
+			while (partial_segments[size_class].empty() && free_segments.empty() && !unswept_segments.empty()) SweepNext();
+
+			if (!partial_segments[size_class].empty())
+			{
+				segment = partial_segments[size_class].back();
+				partial_segments[size_class].pop_back();
+			}
+			else
+			{
+				if (!free_segments.empty())
+				{
+					segment = free_segments.back();
+					free_segments.pop_back();
+
+					reassigned = segment->size_class != size_class;
+				}
+				else
+				{
+					if (!base || commit_end+SEGMENT_SIZE > base+HEAP_RESERVE_SIZE) return nullptr;
+
+					if (!VirtualAlloc(commit_end, SEGMENT_SIZE, MEM_COMMIT, PAGE_READWRITE)) return nullptr;
+
+					if (!VirtualAlloc(card_table+((commit_end-base) >> CARD_SHIFT), SEGMENT_SIZE >> CARD_SHIFT, MEM_COMMIT, PAGE_READWRITE)) return nullptr;
+
+					segment = new Segment();
+
+					segment->start = commit_end;
+
+					segment_table[(commit_end-base) >> SEGMENT_SHIFT] = segment;
+					segments.push_back(segment);
+
+					commit_end+=SEGMENT_SIZE;
+				}
+
+				segment->size_class = size_class;
+				segment->cell_size = SIZE_CLASSES[size_class];
+				segment->num_cells = SEGMENT_SIZE/segment->cell_size;
+
+				// the sweep only nulled the old cell starts, so the new ones can still hold stale object data that a stack scan or heap walk would read as a type ptr
+				if (reassigned)
+				{
+					for (size_t cell = 0; cell < segment->num_cells; cell++) *(void**) (segment->start+(cell*segment->cell_size)) = nullptr;
+				}
+			}
+
+			segment->owned = true;
+
+			return segment;
+		}
+
+		// moves the buffer to the next run of free cells in its segment
+		bool ManagedHeap::NextFreeRun(AllocationBuffer& buffer)
+		{
+			Segment* segment = buffer.segment;
+
+			size_t first = FindBit(segment->alloc_bits, buffer.next_cell, segment->num_cells, false);
+
+			if (first == segment->num_cells) return false;
+
+			size_t last = FindBit(segment->alloc_bits, first, segment->num_cells, true);
+
+			buffer.cursor = segment->start+(first*segment->cell_size);
+			buffer.limit = segment->start+(last*segment->cell_size);
+			buffer.next_cell = first;
+
+			allocated_size+=buffer.limit-buffer.cursor;
+			young_size+=buffer.limit-buffer.cursor;
+
+			return true;
+		}
+
+		char* ManagedHeap::Allocate(size_t size)
+		{
+			if (size > MAX_SMALL_OBJECT_SIZE) return AllocateLarge(size);
+
+			unsigned char size_class = size_class_of[(size+GRANULE-1)/GRANULE];
+			size_t cell_size = SIZE_CLASSES[size_class];
+
+			AllocationBuffer& buffer = thread_buffers.classes[size_class];
+
+			if ((size_t) (buffer.limit-buffer.cursor) < cell_size) return AllocateSlow(thread_buffers, size_class);
+
+			// fast path: bump the cursor and record the object start, the segment belongs to this thread so no lock is needed
+			char* obj = buffer.cursor;
+			size_t cell = buffer.next_cell;
+
+			buffer.cursor+=cell_size;
+			buffer.next_cell++;
+
+			buffer.segment->alloc_bits[cell >> 6].fetch_or(((uint64_t) 1) << (cell & 63), std::memory_order_relaxed);
+
+			return obj;
+		}
+
+		char* ManagedHeap::AllocateSlow(ThreadAllocationBuffers& buffers, unsigned char size_class)
+		{
+			std::lock_guard<std::recursive_mutex> lock(heap_lock);
+
+			if (!buffers.heap)
+			{
+				buffers.heap = this;
+				threads.push_back(&buffers);
+			}
+
+			AllocationBuffer& buffer = buffers.classes[size_class];
+
+			while (!buffer.segment || !NextFreeRun(buffer))
+			{
+				if (buffer.segment) buffer.segment->owned = false; // full, the next sweep lists it again if any of its objects die
+
+				buffer.segment = TakeSegment(size_class);
+				buffer.next_cell = 0;
+
+				if (!buffer.segment)
+				{
+					buffer.cursor = buffer.limit = nullptr;
+
+					return nullptr;
+				}
+			}
+
+			return Allocate(SIZE_CLASSES[size_class]);
+		}
+
+		char* ManagedHeap::AllocateZeroed(size_t size)
+		{
+			if (size > MAX_SMALL_OBJECT_SIZE) return AllocateLarge(size);
+
+			char* mem = Allocate(size);
+
+			if (mem) memset(mem, 0, size);
+
+			return mem;
+		}
+
+		char* ManagedHeap::AllocateLarge(size_t size)
+		{
+			size = (size+LARGE_OBJECT_HEADER_SIZE+LARGE_OBJECT_PAGE-1) & ~(LARGE_OBJECT_PAGE-1);
+
+			char* mem = (char*) VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+
+			if (!mem) return nullptr;
+
+			new (mem) LargeObjectHeader { size };
+
+			char* obj = mem+LARGE_OBJECT_HEADER_SIZE;
+
+			std::lock_guard<std::recursive_mutex> lock(heap_lock);
+
+			large_objs.insert(std::upper_bound(large_objs.begin(), large_objs.end(), obj), obj);
+
+			UpdateLargeObjectBounds();
+
+			allocated_size+=size;
+			young_size+=size;
+
+			return obj;
+		}
+
+		char* ManagedHeap::FindLargeObject(char* addr)
+		{
+			if (addr < large_objs_begin || addr >= large_objs_end) return nullptr;
+
+			auto found = std::upper_bound(large_objs.begin(), large_objs.end(), addr); // the first object starting after addr
+
+			if (found == large_objs.begin()) return nullptr;
+
+			char* obj = *(found-1);
+
+			return (addr < obj-LARGE_OBJECT_HEADER_SIZE+LargeHeaderOf(obj)->size) ? obj : nullptr;
+		}
+
+		void ManagedHeap::UpdateLargeObjectBounds()
+		{
+			if (large_objs.empty())
+			{
+				large_objs_begin = large_objs_end = nullptr;
+				return;
+			}
+
+			// the regions don't overlap, so the last object ends last
+			large_objs_begin = large_objs.front();
+			large_objs_end = large_objs.back()-LARGE_OBJECT_HEADER_SIZE+LargeHeaderOf(large_objs.back())->size;
+		}
+
+		char* ManagedHeap::FindObject(char* obj)
+		{
+			if (obj >= base && obj < commit_end)
+			{
+				Segment* segment = segment_table[(obj-base) >> SEGMENT_SHIFT];
+
+				size_t offset = obj-segment->start;
+
+				if (offset % segment->cell_size) return nullptr;
+
+				size_t cell = offset/segment->cell_size;
+
+				if (cell >= segment->num_cells) return nullptr;
+
+				if (!(segment->alloc_bits[cell >> 6].load(std::memory_order_relaxed) & (((uint64_t) 1) << (cell & 63)))) return nullptr;
+
+				return obj;
+			}
+
+			return (FindLargeObject(obj) == obj) ? obj : nullptr;
+		}
+
+		char* ManagedHeap::FindContainingObject(char* addr)
+		{
+			if (addr >= base && addr < commit_end)
+			{
+				Segment* segment = segment_table[(addr-base) >> SEGMENT_SHIFT];
+
+				size_t cell = (addr-segment->start)/segment->cell_size;
+
+				if (cell >= segment->num_cells) return nullptr; // in the unused tail of the segment
+
+				if (!(segment->alloc_bits[cell >> 6].load(std::memory_order_relaxed) & (((uint64_t) 1) << (cell & 63)))) return nullptr;
+
+				return segment->start+(cell*segment->cell_size);
+			}
+
+			return FindLargeObject(addr);
+		}
+
+		size_t ManagedHeap::SizeOf(char* obj)
+		{
+			if (obj >= base && obj < commit_end) return segment_table[(obj-base) >> SEGMENT_SHIFT]->cell_size;
+
+			return LargeHeaderOf(obj)->size;
+		}
+
+		bool ManagedHeap::Mark(char* obj)
+		{
+			if (obj >= base && obj < commit_end)
+			{
+				Segment* segment = segment_table[(obj-base) >> SEGMENT_SHIFT];
+
+				size_t offset = obj-segment->start;
+
+				if (offset % segment->cell_size) return false;
+
+				size_t cell = offset/segment->cell_size;
+				uint64_t bit = ((uint64_t) 1) << (cell & 63);
+
+				if (cell >= segment->num_cells) return false;
+
+				if (!(segment->alloc_bits[cell >> 6].load(std::memory_order_relaxed) & bit)) return false;
+
+				if (segment->mark_bits[cell >> 6].load(std::memory_order_relaxed) & bit) return false; // avoid the atomic write for objects that are already marked
+
+				return !(segment->mark_bits[cell >> 6].fetch_or(bit, std::memory_order_relaxed) & bit); // another worker may have marked it in the meantime
+			}
+
+			if (!obj || FindLargeObject(obj) != obj) return false;
+
+			LargeObjectHeader* header = LargeHeaderOf(obj);
+
+			if (header->marked.load(std::memory_order_relaxed)) return false;
+
+			return !header->marked.exchange(true);
+		}
+
+		bool ManagedHeap::IsMarked(char* obj)
+		{
+			if (obj >= base && obj < commit_end)
+			{
+				Segment* segment = segment_table[(obj-base) >> SEGMENT_SHIFT];
+
+				size_t offset = obj-segment->start;
+
+				if (offset % segment->cell_size) return false;
+
+				size_t cell = offset/segment->cell_size;
+				uint64_t bit = ((uint64_t) 1) << (cell & 63);
+
+				if (cell >= segment->num_cells) return false;
+
+				return (segment->alloc_bits[cell >> 6].load(std::memory_order_relaxed) & bit) && (segment->mark_bits[cell >> 6].load(std::memory_order_relaxed) & bit);
+			}
+
+			return obj && FindLargeObject(obj) == obj && LargeHeaderOf(obj)->marked;
+		}
+
+		void ManagedHeap::ClearMarks()
+		{
+			for (Segment* segment : segments)
+			{
+				for (auto& bits : segment->mark_bits) bits.store(0, std::memory_order_relaxed);
+
+				// a full collection traces every object anyway
+				memset(card_table+((segment->start-base) >> CARD_SHIFT), 0, SEGMENT_SIZE >> CARD_SHIFT);
+			}
+
+			for (char* obj : large_objs) LargeHeaderOf(obj)->marked = false;
+		}
+
+		void ManagedHeap::ScanMarked(Segment* segment, const std::function<void(char*)>& callback)
+		{
+			size_t num_words = (segment->num_cells+63)/64;
+
+			for (size_t word = 0; word < num_words; word++)
+			{
+				uint64_t bits = segment->mark_bits[word].load(std::memory_order_relaxed) & segment->alloc_bits[word].load(std::memory_order_relaxed);
+
+				for (; bits; bits&=bits-1)
+				{
+					callback(segment->start+(((word << 6)+__builtin_ctzll(bits))*segment->cell_size));
+				}
+			}
+		}
+
+		void ManagedHeap::ForEachMarkedObject(const std::function<void(char*)>& callback)
+		{
+			for (size_t i = 0; i < segments.size(); i++) ScanMarked(segments[i], callback);
+
+			for (char* obj : large_objs)
+			{
+				if (LargeHeaderOf(obj)->marked) callback(obj);
+			}
+		}
+
+		void ManagedHeap::ForEachUnmarkedObject(const std::function<void(char*)>& callback)
+		{
+			for (Segment* segment : segments)
+			{
+				size_t num_words = (segment->num_cells+63)/64;
+
+				for (size_t word = 0; word < num_words; word++)
+				{
+					uint64_t bits = segment->alloc_bits[word].load(std::memory_order_relaxed) & ~segment->mark_bits[word].load(std::memory_order_relaxed);
+
+					for (; bits; bits&=bits-1) callback(segment->start+(((word << 6)+__builtin_ctzll(bits))*segment->cell_size));
+				}
+			}
+
+			for (char* obj : large_objs)
+			{
+				if (!LargeHeaderOf(obj)->marked) callback(obj);
+			}
+		}
+
+		void ManagedHeap::ScanRememberedSegment(size_t index, const std::function<void(char*)>& scan_old)
+		{
+			constexpr size_t CARD_SIZE = 1 << CARD_SHIFT;
+
+			Segment* segment = segments[index];
+
+			unsigned char* cards = card_table+((segment->start-base) >> CARD_SHIFT);
+
+			for (size_t card = 0; card < (SEGMENT_SIZE >> CARD_SHIFT); card++)
+			{
+				if (cards[card] != CARD_DIRTY) continue;
+
+				cards[card] = 0; // survivors of this collection are old, so the card can't hold old-to-young refs afterwards
+
+				// every object whose start lies within the card
+				size_t first_cell = ((card*CARD_SIZE)+segment->cell_size-1)/segment->cell_size;
+				size_t end_cell = std::min((((card+1)*CARD_SIZE)+segment->cell_size-1)/segment->cell_size, segment->num_cells);
+
+				for (size_t cell = first_cell; cell < end_cell; cell++)
+				{
+					uint64_t bit = ((uint64_t) 1) << (cell & 63);
+
+					if ((segment->alloc_bits[cell >> 6].load(std::memory_order_relaxed) & bit) && (segment->mark_bits[cell >> 6].load(std::memory_order_relaxed) & bit))
+					{
+						scan_old(segment->start+(cell*segment->cell_size));
+					}
+				}
+			}
+		}
+
+		void ManagedHeap::ScanRememberedLargeObjects(const std::function<void(char*)>& scan_old)
+		{
+			for (char* obj : large_objs)
+			{
+				if (LargeHeaderOf(obj)->marked) scan_old(obj);
+			}
+		}
+
+		size_t ManagedHeap::SweepSegment(Segment* segment)
+		{
+			size_t num_words = (segment->num_cells+63)/64;
+			size_t live_cells = 0;
+
+			for (size_t word = 0; word < num_words; word++)
+			{
+				uint64_t dead = segment->alloc_bits[word].load(std::memory_order_relaxed) & ~segment->mark_bits[word].load(std::memory_order_relaxed);
+
+				// a freed cell's type ptr stays null until the object allocated in it is initialized
+				for (uint64_t bits = dead; bits; bits&=bits-1)
+				{
+					*(void**) (segment->start+(((word << 6)+__builtin_ctzll(bits))*segment->cell_size)) = nullptr;
+				}
+
+				live_cells+=__builtin_popcountll(segment->alloc_bits[word].fetch_and(~dead, std::memory_order_relaxed) & ~dead);
+			}
+
+			return live_cells;
+		}
+
+		void ManagedHeap::SweepNext()
+		{
+			Segment* segment = unswept_segments.back();
+
+			unswept_segments.pop_back();
+
+			size_t live_cells = SweepSegment(segment);
+
+			if (!live_cells) free_segments.push_back(segment);
+			else if (live_cells < segment->num_cells) partial_segments[segment->size_class].push_back(segment);
+		}
+
+		SweepStats ManagedHeap::BeginSweep()
+		{
+			std::lock_guard<std::recursive_mutex> lock(heap_lock);
+
+			SweepStats stats;
+
+			free_segments.clear();
+			unswept_segments.clear();
+
+			for (auto& list : partial_segments) list.clear();
+
+			size_t live_size = 0;
+
+			for (Segment* segment : segments)
+			{
+				size_t num_words = (segment->num_cells+63)/64;
+				size_t live_cells = 0;
+				size_t dead_cells = 0;
+
+				for (size_t word = 0; word < num_words; word++)
+				{
+					uint64_t alloced = segment->alloc_bits[word].load(std::memory_order_relaxed);
+					uint64_t marked = segment->mark_bits[word].load(std::memory_order_relaxed);
+
+					live_cells+=__builtin_popcountll(alloced & marked);
+					dead_cells+=__builtin_popcountll(alloced & ~marked);
+				}
+
+				live_size+=live_cells*segment->cell_size;
+
+				stats.num_dead+=dead_cells;
+				stats.dead_size+=dead_cells*segment->cell_size;
+
+				// the owning thread allocates into the segment without the lock, so it is swept now instead
+				if (segment->owned) SweepSegment(segment);
+				else if (dead_cells) unswept_segments.push_back(segment);
+				else if (!live_cells) free_segments.push_back(segment);
+				else if (live_cells < segment->num_cells) partial_segments[segment->size_class].push_back(segment);
+			}
+
+			size_t num_kept = 0;
+
+			for (char* obj : large_objs)
+			{
+				LargeObjectHeader* header = LargeHeaderOf(obj);
+
+				if (header->marked)
+				{
+					live_size+=header->size;
+					large_objs[num_kept++] = obj;
+					continue;
+				}
+
+				stats.num_dead++;
+				stats.dead_size+=header->size;
+
+				VirtualFree(header, 0, MEM_RELEASE);
+			}
+
+			large_objs.resize(num_kept);
+
+			UpdateLargeObjectBounds();
+
+			allocated_size = live_size;
+			young_size = 0;
+
+			return stats;
+		}
+
+		void ManagedHeap::FinishSweep()
+		{
+			std::lock_guard<std::recursive_mutex> lock(heap_lock);
+
+			while (!unswept_segments.empty()) SweepNext();
+		}
+
+		void ManagedHeap::Release()
+		{
+			std::lock_guard<std::recursive_mutex> lock(heap_lock);
+
+			for (ThreadAllocationBuffers* buffers : threads)
+			{
+				buffers->heap = nullptr;
+
+				for (auto& buffer : buffers->classes) buffer = AllocationBuffer();
+			}
+
+			threads.clear();
+
+			for (char* obj : large_objs) VirtualFree(LargeHeaderOf(obj), 0, MEM_RELEASE);
+
+			large_objs.clear();
+
+			large_objs_begin = large_objs_end = nullptr;
+
+			for (Segment* segment : segments) delete segment;
+
+			segments.clear();
+			free_segments.clear();
+			unswept_segments.clear();
+
+			for (auto& list : partial_segments) list.clear();
+
+			if (base) VirtualFree(base, 0, MEM_RELEASE);
+			if (card_table) VirtualFree(card_table, 0, MEM_RELEASE);
+
+			delete[] segment_table;
+
+			base = commit_end = nullptr;
+			card_table = nullptr;
+			segment_table = nullptr;
+
+			allocated_size = 0;
+			young_size = 0;
+		}
+	}
+}
@@ -0,0 +1,83 @@
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#pragma once
+
+// kept free of the runtime's (and Windows') headers, so that offline tools can read snapshots too
+namespace ULR::Heap
+{
+	/*
+		Heap snapshot format, every integer is an unsigned LEB128 varint and every address is divided by SNAPSHOT_ADDRESS_ALIGNMENT:
+			SNAPSHOT_MAGIC (8 bytes)
+			records, each starting with its tag byte:
+				SnapshotType: type id, name length, name
+				SnapshotObject: address, type id (0 if its header wasn't written yet), size, number of refs, address of each referenced object
+				SnapshotRoot: root kind, address, name length, name (the static field for static roots, empty otherwise)
+			SnapshotEnd
+		A type is written before the first object of it, refs may point to objects written later and an object may be referenced by several roots.
+	*/
+	constexpr char SNAPSHOT_MAGIC[8] = { 'U', 'L', 'R', 'H', 'E', 'A', 'P', '1' };
+	constexpr size_t SNAPSHOT_ADDRESS_ALIGNMENT = 16; // every object starts on a granule
+
+	enum SnapshotTag : unsigned char
+	{
+		SnapshotEnd,
+		SnapshotType,
+		SnapshotObject,
+		SnapshotRoot
+	};
+
+	enum class RootKind : unsigned char
+	{
+		Stack, // conservatively, including the registers of suspended threads
+		Static,
+		Finalizer, // waiting for its dtor
+		Handle // strong or pinned GC handle
+	};
+
+	// buffered, so the snapshot never holds more than a buffer of the heap in memory
+	class SnapshotWriter
+	{
+		std::ofstream out;
+		std::string buffer;
+
+		void WriteVarint(uint64_t value);
+		void WriteString(const std::string& str);
+		void Flush();
+
+		public:
+			bool Open(const char* path);
+			void WriteType(uint64_t id, const std::string& name);
+			void WriteObject(char* obj, uint64_t type_id, size_t size, const std::vector<char*>& refs);
+			void WriteRoot(RootKind kind, char* obj, const std::string& name);
+			bool Close(); // writes the end record, returns whether everything was written
+	};
+
+	struct SnapshotRecord
+	{
+		SnapshotTag tag;
+		uint64_t address; // object & root records
+		uint64_t type_id; // type & object records
+		size_t size;
+		RootKind root_kind;
+		std::string name; // type & root records
+		std::vector<uint64_t> refs;
+	};
+
+	class SnapshotReader
+	{
+		std::ifstream in;
+		bool malformed = false;
+
+		uint64_t ReadVarint();
+		std::string ReadString();
+
+		public:
+			bool Open(const char* path); // false if the file can't be read or isn't a snapshot
+			bool Next(SnapshotRecord& record); // false after the end record or if the file is malformed
+			bool Malformed() { return malformed; }
+	};
+}
@@ -0,0 +1,200 @@
+#include "../HeapSnapshot.hpp"
+#include <algorithm>
+#include <cstring>
+
+const size_t SNAPSHOT_BUFFER_SIZE = 1 << 20;
+const size_t MAX_SNAPSHOT_STRING = 1 << 16;
+
+namespace ULR::Heap
+{
+	bool SnapshotWriter::Open(const char* path)
+	{
+		out.open(path, std::ios::binary | std::ios::trunc);
+
+		if (!out) return false;
+
+		buffer.reserve(SNAPSHOT_BUFFER_SIZE+MAX_SNAPSHOT_STRING);
+		buffer.append(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+
+		return true;
+	}
+
+	void SnapshotWriter::WriteVarint(uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			buffer.push_back((char) (value | 0x80));
+
+			value >>= 7;
+		}
+
+		buffer.push_back((char) value);
+	}
+
+	void SnapshotWriter::WriteString(const std::string& str)
+	{
+		size_t len = std::min(str.size(), MAX_SNAPSHOT_STRING);
+
+		WriteVarint(len);
+
+		buffer.append(str.data(), len);
+	}
+
+	void SnapshotWriter::Flush()
+	{
+		if (buffer.size() < SNAPSHOT_BUFFER_SIZE) return;
+
+		out.write(buffer.data(), buffer.size());
+
+		buffer.clear();
+	}
+
+	void SnapshotWriter::WriteType(uint64_t id, const std::string& name)
+	{
+		buffer.push_back(SnapshotType);
+
+		WriteVarint(id);
+		WriteString(name);
+
+		Flush();
+	}
+
+	void SnapshotWriter::WriteObject(char* obj, uint64_t type_id, size_t size, const std::vector<char*>& refs)
+	{
+		buffer.push_back(SnapshotObject);
+
+		WriteVarint(((uint64_t) obj)/SNAPSHOT_ADDRESS_ALIGNMENT);
+		WriteVarint(type_id);
+		WriteVarint(size);
+		WriteVarint(refs.size());
+
+		for (char* ref : refs) WriteVarint(((uint64_t) ref)/SNAPSHOT_ADDRESS_ALIGNMENT);
+
+		Flush();
+	}
+
+	void SnapshotWriter::WriteRoot(RootKind kind, char* obj, const std::string& name)
+	{
+		buffer.push_back(SnapshotRoot);
+		buffer.push_back((char) kind);
+
+		WriteVarint(((uint64_t) obj)/SNAPSHOT_ADDRESS_ALIGNMENT);
+		WriteString(name);
+
+		Flush();
+	}
+
+	bool SnapshotWriter::Close()
+	{
+		buffer.push_back(SnapshotEnd);
+
+		out.write(buffer.data(), buffer.size());
+		out.close();
+
+		buffer.clear();
+		buffer.shrink_to_fit();
+
+		return !out.fail();
+	}
+
+	bool SnapshotReader::Open(const char* path)
+	{
+		in.open(path, std::ios::binary);
+
+		char magic[sizeof(SNAPSHOT_MAGIC)];
+
+		if (!in.read(magic, sizeof(magic))) return false;
+
+		return memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0;
+	}
+
+	uint64_t SnapshotReader::ReadVarint()
+	{
+		uint64_t value = 0;
+
+		for (int shift = 0; shift < 64; shift+=7)
+		{
+			int byte = in.get();
+
+			if (byte == EOF)
+			{
+				malformed = true;
+
+				return 0;
+			}
+
+			value |= ((uint64_t) (byte & 0x7F)) << shift;
+
+			if (!(byte & 0x80)) return value;
+		}
+
+		malformed = true;
+
+		return 0;
+	}
+
+	std::string SnapshotReader::ReadString()
+	{
+		size_t len = ReadVarint();
+
+		if (len > MAX_SNAPSHOT_STRING)
+		{
+			malformed = true;
+
+			return "";
+		}
+
+		std::string str(len, '\0');
+
+		if (!in.read(str.data(), len)) malformed = true;
+
+		return str;
+	}
+
+	bool SnapshotReader::Next(SnapshotRecord& record)
+	{
+		int tag = in.get();
+
+		if (tag == EOF)
+		{
+			malformed = true; // truncated, the end record is missing
+
+			return false;
+		}
+
+		record.tag = (SnapshotTag) tag;
+
+		switch (record.tag)
+		{
+			case SnapshotEnd:
+				return false;
+			case SnapshotType:
+				record.type_id = ReadVarint();
+				record.name = ReadString();
+				break;
+			case SnapshotObject:
+			{
+				record.address = ReadVarint()*SNAPSHOT_ADDRESS_ALIGNMENT;
+				record.type_id = ReadVarint();
+				record.size = ReadVarint();
+
+				size_t num_refs = ReadVarint();
+
+				record.refs.clear();
+
+				for (size_t i = 0; i < num_refs && !malformed; i++) record.refs.push_back(ReadVarint()*SNAPSHOT_ADDRESS_ALIGNMENT);
+
+				break;
+			}
+			case SnapshotRoot:
+				record.root_kind = (RootKind) in.get();
+				record.address = ReadVarint()*SNAPSHOT_ADDRESS_ALIGNMENT;
+				record.name = ReadString();
+				break;
+			default:
+				malformed = true;
+		}
+
+		return !malformed;
+	}
+}
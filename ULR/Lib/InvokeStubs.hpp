@@ -0,0 +1,84 @@
+#include "Assembly.hpp"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#pragma once
+
+namespace ULR::Resolver
+{
+	enum class CallingConvention : unsigned char
+	{
+		Win64,
+		SysV // System V AMD64
+	};
+
+	#ifdef _WIN64
+	constexpr CallingConvention NATIVE_CALLING_CONVENTION = CallingConvention::Win64;
+	#else
+	constexpr CallingConvention NATIVE_CALLING_CONVENTION = CallingConvention::SysV;
+	#endif
+
+	// how a reflection arg gets from its box (or, for unboxed calls, its storage) to the callee
+	enum class InvokeArgKind : unsigned char
+	{
+		Ref, // passed as is
+		Unboxed, // a ptr to the data of a struct (struct 'this' ptrs, and structs larger than 8 bytes under Win64)
+		Value, // a struct of up to 8 bytes, loaded
+		Float, // Float32 or Float64, loaded into a vector register
+		Struct // a struct larger than 8 bytes passed by value (System V), copied
+	};
+
+	enum class InvokeReturnKind : unsigned char
+	{
+		Void,
+		Integer, // rax
+		Float, // xmm0
+		Pair, // structs of 9 to 16 bytes under System V, one eightbyte per register (rax then rdx, or xmm0 then xmm1 for the vector ones)
+		Hidden // the caller passes the return storage as a hidden first arg
+	};
+
+	struct InvokeShape
+	{
+		bool has_this = false; // the first entry of `args` is 'this'
+		bool unboxed = false; // args point to the values themselves instead of their boxes, and self is passed as is
+		std::vector<InvokeArgKind> args;
+		std::vector<uint32_t> sizes; // of the values, in bytes
+		std::vector<uint8_t> sse_words; // System V: bit n is set when eightbyte n of a struct only holds Float32/Float64 fields, and goes in a vector register
+		InvokeReturnKind ret = InvokeReturnKind::Void;
+		uint32_t ret_size = 0;
+		uint8_t ret_sse_words = 0;
+	};
+
+	/*
+		Calls target(self?, args...) and stores exactly ret_size bytes of the return value to ret (ret is the hidden return storage for Hidden).
+		args holds the boxed args (without self), or ptrs to their storage for unboxed stubs (a ref variable for a ref arg), and the stub loads them
+		as the calling convention requires.
+	*/
+	typedef void (*InvokeStub)(void* target, char* self, void* const* args, void* ret);
+
+	// machine code trampolines for reflection calls, generated once per distinct signature shape
+	class InvokeStubCache
+	{
+		CallingConvention convention;
+		std::unordered_map<std::string, InvokeStub> stubs; // by the encoded shape
+		std::mutex lock;
+		std::vector<std::pair<void*, size_t>> code_pages; // with their sizes, which munmap needs
+		char* code_cursor = nullptr;
+		char* code_end = nullptr;
+
+		InvokeStub Emit(const InvokeShape& shape);
+
+		public:
+			InvokeStubCache(CallingConvention convention = NATIVE_CALLING_CONVENTION);
+			~InvokeStubCache();
+
+			// this_type is nullptr for static methods, rettype for ctors
+			InvokeShape ShapeOf(Type* this_type, const std::vector<Type*>& argsig, Type* rettype, bool unboxed);
+			InvokeStub GetStub(const InvokeShape& shape);
+			InvokeStub GetStub(Type* this_type, const std::vector<Type*>& argsig, Type* rettype, bool unboxed);
+			size_t NumStubs();
+	};
+}
@@ -0,0 +1,531 @@
+#include "../InvokeStubs.hpp"
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#include <algorithm>
+#include <cstring>
+
+const size_t STUB_CODE_CHUNK = 1 << 16;
+const size_t STUB_ALIGNMENT = 16;
+
+namespace ULR::Resolver
+{
+	using byte = unsigned char;
+
+	enum Register : byte { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+	const byte WIN64_INT_ARGS[] = { RCX, RDX, R8, R9 };
+	const byte SYSV_INT_ARGS[] = { RDI, RSI, RDX, RCX, R8, R9 };
+	const size_t SYSV_NUM_XMM_ARGS = 8;
+	const size_t WIN64_SHADOW_SPACE = 32;
+
+	static byte Rex(bool wide, byte reg, byte base)
+	{
+		return 0x40 | (wide ? 0x08 : 0) | ((reg >> 3) << 2) | (base >> 3);
+	}
+
+	// mov dst, src
+	static void EmitMov(std::vector<byte>& code, byte dst, byte src)
+	{
+		code.insert(code.end(), { Rex(true, src, dst), 0x89, (byte) (0xC0 | ((src & 7) << 3) | (dst & 7)) });
+	}
+
+	// ModRM (and SIB) for [base+disp32]
+	static void EmitAddress(std::vector<byte>& code, byte reg, byte base, int32_t disp)
+	{
+		code.push_back(0x80 | ((reg & 7) << 3) | (base & 7));
+
+		if ((base & 7) == RSP) code.push_back(0x24); // rsp and r12 need a SIB byte
+
+		code.insert(code.end(), (byte*) &disp, ((byte*) &disp)+sizeof(int32_t));
+	}
+
+	// size is 1, 2, 4 or 8, the value is zero-extended
+	static void EmitLoadWord(std::vector<byte>& code, byte dst, byte base, int32_t disp, size_t size)
+	{
+		switch (size)
+		{
+			case 1: code.insert(code.end(), { Rex(true, dst, base), 0x0F, 0xB6 }); break; // movzx
+			case 2: code.insert(code.end(), { Rex(true, dst, base), 0x0F, 0xB7 }); break;
+			case 4: code.insert(code.end(), { Rex(false, dst, base), 0x8B }); break; // writing the 32 bit register clears the upper half
+			default: code.insert(code.end(), { Rex(true, dst, base), 0x8B }); break;
+		}
+
+		EmitAddress(code, dst, base, disp);
+	}
+
+	static void EmitStoreWord(std::vector<byte>& code, byte base, int32_t disp, byte src, size_t size)
+	{
+		switch (size)
+		{
+			case 1: code.insert(code.end(), { Rex(false, src, base), 0x88 }); break;
+			case 2: code.insert(code.end(), { 0x66, Rex(false, src, base), 0x89 }); break;
+			case 4: code.insert(code.end(), { Rex(false, src, base), 0x89 }); break;
+			default: code.insert(code.end(), { Rex(true, src, base), 0x89 }); break;
+		}
+
+		EmitAddress(code, src, base, disp);
+	}
+
+	static bool IsWordSize(size_t size)
+	{
+		return size == 1 || size == 2 || size == 4 || size == 8;
+	}
+
+	// loads exactly size (at most 8) bytes, so values are never read past their end
+	static void EmitLoad(std::vector<byte>& code, byte dst, byte base, int32_t disp, size_t size)
+	{
+		if (IsWordSize(size))
+		{
+			EmitLoadWord(code, dst, base, disp, size);
+			return;
+		}
+
+		// odd sizes are assembled in r11, from the highest byte down
+		code.insert(code.end(), { 0x45, 0x31, 0xDB }); // xor r11d, r11d
+
+		for (size_t i = size; i-- > 0;)
+		{
+			code.insert(code.end(), { 0x49, 0xC1, 0xE3, 0x08 }); // shl r11, 8
+			code.insert(code.end(), { Rex(false, R11, base), 0x8A }); // mov r11b, [base+disp+i]
+
+			EmitAddress(code, R11, base, disp+(int32_t) i);
+		}
+
+		EmitMov(code, dst, R11);
+	}
+
+	// stores exactly size (at most 8) bytes, clobbers src for odd sizes
+	static void EmitStore(std::vector<byte>& code, byte base, int32_t disp, byte src, size_t size)
+	{
+		if (IsWordSize(size))
+		{
+			EmitStoreWord(code, base, disp, src, size);
+			return;
+		}
+
+		for (size_t i = 0; i < size; i++)
+		{
+			EmitStoreWord(code, base, disp+(int32_t) i, src, 1);
+
+			code.insert(code.end(), { Rex(true, 0, src), 0xC1, (byte) (0xE8 | (src & 7)), 0x08 }); // shr src, 8
+		}
+	}
+
+	// movq xmm, src
+	static void EmitMovToXmm(std::vector<byte>& code, byte xmm, byte src)
+	{
+		code.insert(code.end(), { 0x66, Rex(true, xmm, src), 0x0F, 0x6E, (byte) (0xC0 | ((xmm & 7) << 3) | (src & 7)) });
+	}
+
+	// movq dst, xmm
+	static void EmitMovFromXmm(std::vector<byte>& code, byte dst, byte xmm)
+	{
+		code.insert(code.end(), { 0x66, Rex(true, xmm, dst), 0x0F, 0x7E, (byte) (0xC0 | ((xmm & 7) << 3) | (dst & 7)) });
+	}
+
+	// marks the eightbytes (from the start of the outermost struct) that the fields of a struct at `base` touch, nested structs are flattened
+	static void ClassifyEightbytes(Type* type, size_t base, uint8_t& integer, uint8_t& sse)
+	{
+		if (IsFloatingPointType(type))
+		{
+			sse |= 1 << (base/8);
+			return;
+		}
+
+		bool has_fields = false;
+
+		if (IsBoxableStruct(type))
+		{
+			for (Type* layout = type; layout; layout = layout->immediate_base)
+			{
+				for (auto& entry : layout->inst_attrs)
+				{
+					for (auto member : entry.second)
+					{
+						if (member->decl_type != MemberType::Field) continue;
+
+						FieldInfo* field = (FieldInfo*) member;
+
+						has_fields = true;
+
+						if (IsBoxableStruct(field->valtype)) ClassifyEightbytes(field->valtype, base+(size_t) field->offset, integer, sse); // struct field offsets don't include the type ptr
+						else integer |= 1 << ((base+(size_t) field->offset)/8);
+					}
+				}
+			}
+		}
+
+		if (has_fields) return;
+
+		// primitives (and structs whose layout isn't described) are integer data
+		size_t size = IsBoxableStruct(type) ? type->size : sizeof(char*);
+
+		for (size_t word = base/8; word < (base+size+7)/8 && word < 8; word++) integer |= 1 << word;
+	}
+
+	// System V: an eightbyte goes in a vector register when it only holds floating point fields (padding doesn't count)
+	static uint8_t SSEWordsOf(Type* type)
+	{
+		if (type->size > 16) return 0; // passed in memory
+
+		uint8_t integer = 0;
+		uint8_t sse = 0;
+
+		ClassifyEightbytes(type, 0, integer, sse);
+
+		return sse & ~integer;
+	}
+
+	// where an arg (or one eightbyte of it) goes
+	struct ArgLocation
+	{
+		enum { IntRegister, XmmRegister, Stack } kind;
+		byte reg;
+		int32_t offset; // from rsp
+	};
+
+	InvokeStubCache::InvokeStubCache(CallingConvention convention)
+	{
+		this->convention = convention;
+	}
+
+	InvokeStubCache::~InvokeStubCache()
+	{
+		for (auto& page : code_pages)
+		{
+			#ifdef _WIN32
+			VirtualFree(page.first, 0, MEM_RELEASE);
+			#else
+			munmap(page.first, page.second);
+			#endif
+		}
+	}
+
+	InvokeShape InvokeStubCache::ShapeOf(Type* this_type, const std::vector<Type*>& argsig, Type* rettype, bool unboxed)
+	{
+		InvokeShape shape;
+
+		shape.unboxed = unboxed;
+
+		if (this_type)
+		{
+			shape.has_this = true;
+			shape.args.push_back(IsBoxableStruct(this_type) ? InvokeArgKind::Unboxed : InvokeArgKind::Ref); // give an illusion of an unboxed 'this' ptr by skipping the type ptr
+			shape.sizes.push_back(0);
+			shape.sse_words.push_back(0);
+		}
+
+		bool sysv = convention == CallingConvention::SysV;
+
+		for (Type* type : argsig)
+		{
+			InvokeArgKind kind = InvokeArgKind::Ref;
+
+			if (IsBoxableStruct(type))
+			{
+				if (IsFloatingPointType(type)) kind = InvokeArgKind::Float;
+				else if (IsFriendlyStructSizex64(type)) kind = InvokeArgKind::Value;
+				else kind = (convention == CallingConvention::Win64) ? InvokeArgKind::Unboxed : InvokeArgKind::Struct;
+			}
+
+			shape.args.push_back(kind);
+			shape.sizes.push_back(type->size);
+			shape.sse_words.push_back((sysv && (kind == InvokeArgKind::Value || kind == InvokeArgKind::Struct)) ? SSEWordsOf(type) : 0);
+		}
+
+		if (!rettype) return shape;
+
+		shape.ret_size = IsBoxableStruct(rettype) ? rettype->size : sizeof(char*);
+
+		if (!IsBoxableStruct(rettype)) shape.ret = InvokeReturnKind::Integer;
+		else if (IsFloatingPointType(rettype)) shape.ret = InvokeReturnKind::Float;
+		else if (sysv && rettype->size <= 16)
+		{
+			shape.ret_sse_words = SSEWordsOf(rettype);
+
+			if (!IsFriendlyStructSizex64(rettype)) shape.ret = InvokeReturnKind::Pair;
+			else if (shape.ret_sse_words) shape.ret = InvokeReturnKind::Float; // a struct of floats of 4 or 8 bytes comes back in xmm0 alone
+			else shape.ret = InvokeReturnKind::Integer;
+		}
+		else if (IsFriendlyStructSizex64(rettype)) shape.ret = InvokeReturnKind::Integer;
+		else shape.ret = InvokeReturnKind::Hidden;
+
+		return shape;
+	}
+
+	InvokeStub InvokeStubCache::GetStub(Type* this_type, const std::vector<Type*>& argsig, Type* rettype, bool unboxed)
+	{
+		return GetStub(ShapeOf(this_type, argsig, rettype, unboxed));
+	}
+
+	InvokeStub InvokeStubCache::GetStub(const InvokeShape& shape)
+	{
+		std::string key;
+
+		key.push_back((char) shape.has_this);
+		key.push_back((char) shape.unboxed);
+		key.push_back((char) shape.ret);
+		key.append((char*) &shape.ret_size, sizeof(uint32_t));
+		key.push_back((char) shape.ret_sse_words);
+
+		for (size_t i = 0; i < shape.args.size(); i++)
+		{
+			key.push_back((char) shape.args[i]);
+
+			if (shape.args[i] != InvokeArgKind::Ref && shape.args[i] != InvokeArgKind::Unboxed)
+			{
+				key.append((char*) &shape.sizes[i], sizeof(uint32_t)); // values are loaded by their exact size
+				key.push_back((char) (i < shape.sse_words.size() ? shape.sse_words[i] : 0)); // hand-built shapes may leave it out
+			}
+		}
+
+		std::lock_guard<std::mutex> guard(lock);
+
+		auto found = stubs.find(key);
+
+		if (found != stubs.end()) return found->second;
+
+		InvokeStub stub = Emit(shape);
+
+		if (stub) stubs.emplace(std::move(key), stub);
+
+		return stub;
+	}
+
+	size_t InvokeStubCache::NumStubs()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+
+		return stubs.size();
+	}
+
+	InvokeStub InvokeStubCache::Emit(const InvokeShape& shape)
+	{
+		bool win64 = convention == CallingConvention::Win64;
+
+		const byte* int_args = win64 ? WIN64_INT_ARGS : SYSV_INT_ARGS;
+		size_t num_int_args = win64 ? 4 : 6;
+		size_t num_xmm_args = win64 ? 4 : SYSV_NUM_XMM_ARGS;
+		int32_t stack_base = win64 ? WIN64_SHADOW_SPACE : 0;
+
+		// the hidden return storage comes first, then 'this' and the args
+		std::vector<InvokeArgKind> kinds;
+		std::vector<uint32_t> sizes;
+		std::vector<uint8_t> sse_words;
+
+		if (shape.ret == InvokeReturnKind::Hidden)
+		{
+			kinds.push_back(InvokeArgKind::Ref);
+			sizes.push_back(0);
+			sse_words.push_back(0);
+		}
+
+		size_t first_arg = kinds.size();
+
+		kinds.insert(kinds.end(), shape.args.begin(), shape.args.end());
+		sizes.insert(sizes.end(), shape.sizes.begin(), shape.sizes.end());
+		sse_words.insert(sse_words.end(), shape.sse_words.begin(), shape.sse_words.end());
+		sse_words.resize(kinds.size(), 0);
+
+		/* assign locations, Win64 gives every arg the register (or stack slot) of its position, System V counts each register class separately */
+		std::vector<std::vector<ArgLocation>> locations(kinds.size());
+
+		size_t next_int = 0;
+		size_t next_xmm = 0;
+		size_t stack_words = 0;
+
+		for (size_t i = 0; i < kinds.size(); i++)
+		{
+			if (win64 && kinds[i] == InvokeArgKind::Struct) kinds[i] = InvokeArgKind::Unboxed; // large structs are passed by reference
+
+			size_t words = (kinds[i] == InvokeArgKind::Struct) ? (sizes[i]+7)/8 : 1;
+
+			if (win64)
+			{
+				if (i < num_int_args) locations[i].push_back({ kinds[i] == InvokeArgKind::Float ? ArgLocation::XmmRegister : ArgLocation::IntRegister, kinds[i] == InvokeArgKind::Float ? (byte) i : int_args[i], 0 });
+				else locations[i].push_back({ ArgLocation::Stack, 0, (int32_t) (stack_base+(stack_words++)*8) });
+
+				continue;
+			}
+
+			if (kinds[i] == InvokeArgKind::Float && next_xmm < num_xmm_args)
+			{
+				locations[i].push_back({ ArgLocation::XmmRegister, (byte) next_xmm++, 0 });
+				continue;
+			}
+
+			// structs of more than 16 bytes go to memory, smaller ones are split into eightbytes if all of them fit in the remaining registers of their class
+			size_t num_sse = 0;
+
+			for (size_t word = 0; word < words; word++) if (sse_words[i] & (1 << word)) num_sse++;
+
+			if (kinds[i] != InvokeArgKind::Float && words <= 2 && next_int+words-num_sse <= num_int_args && next_xmm+num_sse <= num_xmm_args)
+			{
+				for (size_t word = 0; word < words; word++)
+				{
+					if (sse_words[i] & (1 << word)) locations[i].push_back({ ArgLocation::XmmRegister, (byte) next_xmm++, 0 });
+					else locations[i].push_back({ ArgLocation::IntRegister, int_args[next_int++], 0 });
+				}
+
+				continue;
+			}
+
+			for (size_t word = 0; word < words; word++) locations[i].push_back({ ArgLocation::Stack, 0, (int32_t) (stack_base+(stack_words++)*8) });
+		}
+
+		// four pushes after the return address, so the frame keeps rsp 16 byte aligned at the call if it is 8 mod 16
+		int32_t frame = (int32_t) (((stack_base+stack_words*8+15) & ~((size_t) 15))+8);
+
+		std::vector<byte> code;
+
+		/*
+			push rbp
+			mov rbp, rsp
+			push rbx
+			push r12
+			push r13
+			sub rsp, frame
+		*/
+
+		code.insert(code.end(), { 0x55, 0x48, 0x89, 0xE5, 0x53, 0x41, 0x54, 0x41, 0x55 });
+		code.insert(code.end(), { 0x48, 0x81, 0xEC });
+		code.insert(code.end(), (byte*) &frame, ((byte*) &frame)+sizeof(int32_t));
+
+		// target -> r10, self -> r13, args -> rbx, ret -> r12 (the last three are callee-saved, r10 isn't an arg register in either convention)
+		EmitMov(code, R10, int_args[0]);
+		EmitMov(code, R13, int_args[1]);
+		EmitMov(code, RBX, int_args[2]);
+		EmitMov(code, R12, int_args[3]);
+
+		int32_t data = shape.unboxed ? 0 : sizeof(Type*); // where the value starts
+
+		for (size_t i = 0; i < kinds.size(); i++)
+		{
+			bool is_this = shape.has_this && i == first_arg;
+
+			// the boxed arg or its storage (or the hidden return storage/self) -> rax
+			if (i < first_arg) EmitMov(code, RAX, R12);
+			else if (is_this) EmitMov(code, RAX, R13);
+			else EmitLoad(code, RAX, RBX, (int32_t) ((i-first_arg-shape.has_this)*sizeof(void*)), sizeof(void*));
+
+			if (kinds[i] == InvokeArgKind::Struct)
+			{
+				for (size_t word = 0; word < locations[i].size(); word++)
+				{
+					int32_t disp = (int32_t) (data+word*8);
+					size_t size = std::min((size_t) 8, sizes[i]-word*8);
+
+					if (locations[i][word].kind == ArgLocation::IntRegister)
+					{
+						EmitLoad(code, locations[i][word].reg, RAX, disp, size);
+						continue;
+					}
+
+					EmitLoad(code, R11, RAX, disp, size);
+
+					if (locations[i][word].kind == ArgLocation::XmmRegister) EmitMovToXmm(code, locations[i][word].reg, R11);
+					else EmitStore(code, RSP, locations[i][word].offset, R11, 8);
+				}
+
+				continue;
+			}
+
+			if (is_this || i < first_arg)
+			{
+				if (kinds[i] == InvokeArgKind::Unboxed && !shape.unboxed) code.insert(code.end(), { 0x48, 0x83, 0xC0, (byte) sizeof(Type*) }); // add rax, 8
+			}
+			else if (kinds[i] == InvokeArgKind::Ref && shape.unboxed) EmitLoad(code, RAX, RAX, 0, sizeof(char*));
+			else if (kinds[i] == InvokeArgKind::Unboxed && !shape.unboxed) code.insert(code.end(), { 0x48, 0x83, 0xC0, (byte) sizeof(Type*) });
+			else if (kinds[i] == InvokeArgKind::Value || kinds[i] == InvokeArgKind::Float) EmitLoad(code, RAX, RAX, data, sizes[i]);
+
+			ArgLocation& location = locations[i][0];
+
+			if (location.kind == ArgLocation::IntRegister) EmitMov(code, location.reg, RAX);
+			else if (location.kind == ArgLocation::XmmRegister) EmitMovToXmm(code, location.reg, RAX);
+			else EmitStore(code, RSP, location.offset, RAX, 8);
+		}
+
+		code.insert(code.end(), { 0x41, 0xFF, 0xD2 }); // call r10
+
+		switch (shape.ret)
+		{
+			case InvokeReturnKind::Integer:
+				EmitStore(code, R12, 0, RAX, shape.ret_size);
+				break;
+			case InvokeReturnKind::Float:
+				if (shape.ret_size == 4) code.insert(code.end(), { 0x66, 0x41, 0x0F, 0x7E, 0x04, 0x24 }); // movd [r12], xmm0
+				else code.insert(code.end(), { 0x66, 0x41, 0x0F, 0xD6, 0x04, 0x24 }); // movq [r12], xmm0
+				break;
+			case InvokeReturnKind::Pair:
+			{
+				// integer eightbytes come back in rax then rdx, vector ones in xmm0 then xmm1, whatever their order in the struct
+				byte next_ret_int = RAX;
+				byte next_ret_xmm = 0;
+
+				for (uint32_t word = 0; word*8 < shape.ret_size; word++)
+				{
+					size_t size = std::min((size_t) 8, (size_t) (shape.ret_size-word*8));
+
+					if (shape.ret_sse_words & (1 << word))
+					{
+						EmitMovFromXmm(code, R11, next_ret_xmm++);
+						EmitStore(code, R12, (int32_t) (word*8), R11, size);
+						continue;
+					}
+
+					EmitStore(code, R12, (int32_t) (word*8), next_ret_int, size);
+
+					next_ret_int = RDX;
+				}
+
+				break;
+			}
+			default: break;
+		}
+
+		/*
+			lea rsp, [rbp-24]
+			pop r13
+			pop r12
+			pop rbx
+			pop rbp
+			ret
+		*/
+
+		code.insert(code.end(), { 0x48, 0x8D, 0x65, 0xE8, 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0x5D, 0xC3 });
+
+		// stubs are small and live as long as the runtime, so they are packed into pages that stay writable (a page can't be flipped while another thread runs a stub in it)
+		if (code_cursor+code.size() > code_end)
+		{
+			size_t chunk_size = std::max(STUB_CODE_CHUNK, code.size());
+
+			#ifdef _WIN32
+			char* page = (char*) VirtualAlloc(NULL, chunk_size, MEM_RESERVE | MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+			#else
+			char* page = (char*) mmap(NULL, chunk_size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+			if (page == (char*) MAP_FAILED) page = nullptr;
+			#endif
+
+			if (!page) return nullptr;
+
+			code_pages.emplace_back(page, chunk_size);
+
+			code_cursor = page;
+			code_end = page+chunk_size;
+		}
+
+		char* stub = code_cursor;
+
+		memcpy(stub, code.data(), code.size());
+
+		code_cursor = (char*) ((((size_t) code_cursor)+code.size()+STUB_ALIGNMENT-1) & ~(STUB_ALIGNMENT-1));
+
+		if (code_cursor > code_end) code_cursor = code_end;
+
+		return (InvokeStub) stub;
+	}
+}
@@ -3,6 +3,7 @@
 #include <memory>
 #include <vector>
 #include <map>
+#include <unordered_map>
 
 #pragma once
 
@@ -16,6 +17,7 @@ namespace ULR::Loader
 {
 	extern std::map<std::string_view, Assembly*> ReadAssemblies;
 	extern std::map<std::string_view, Assembly*> LoadedAssemblies;
+	extern std::unordered_map<std::string_view, Type*> TypeIndex;
 	extern std::vector<GenericPlaceholder*> alloced_generic_placeholders;
 
 	ULRResult<HMODULE> ReadNativeAssembly(const char* dll);
@@ -15,6 +15,7 @@ namespace ULR::Loader
 {
 	std::map<std::string_view, Assembly*> ReadAssemblies;
 	std::map<std::string_view, Assembly*> LoadedAssemblies;
+	std::unordered_map<std::string_view, Type*> TypeIndex;
 
 	std::vector<GenericPlaceholder*> alloced_generic_placeholders;
 
@@ -193,6 +194,7 @@ namespace ULR::Loader
 			while (meta[i] != '\n') i++;
 
 			assembly->types[type->name] = type;
+			TypeIndex.emplace(type->name, type);
 
 			i++; // skip newline
 		}
@@ -402,6 +404,8 @@ namespace ULR::Loader
 					{
 						i+=6; // skip the semicolon too (5+1 chars)
 
+						nummember++; // like every other member, otherwise the finalizer thread would call the previous member's code as the dtor
+
 						if (is_generic) type->AddStaticMember(new DestructorInfo(nullptr, Modifiers::Private, true, (char*) addr[nummember]));
 						else type->AddStaticMember(new DestructorInfo(addr[nummember], Modifiers::Private, false));
 
@@ -703,7 +707,7 @@ namespace ULR::Loader
 						}
 
 						if (attrs & Modifiers::Static) type->AddStaticMember(new PropertyInfo(strdup(propname.c_str()), true, proptype, getter, setter, attrs, is_generic));
-						else type->AddInstanceMember(new PropertyInfo(strdup(propname.c_str()), true, proptype, getter, setter, attrs, is_generic));
+						else type->AddInstanceMember(new PropertyInfo(strdup(propname.c_str()), false, proptype, getter, setter, attrs, is_generic));
 
 						continue;
 					}
@@ -791,7 +795,7 @@ namespace ULR::Loader
 				else
 				{
 					if (is_generic) type->AddInstanceMember(new MethodInfo(strdup(func_name.c_str()), false, argsig, rettype_resolved.result, 0, attrs, true, (char*) addr[nummember]));
-					else type->AddInstanceMember(new MethodInfo(strdup(func_name.c_str()), true, argsig, rettype_resolved.result, addr[nummember], attrs, false));
+					else type->AddInstanceMember(new MethodInfo(strdup(func_name.c_str()), false, argsig, rettype_resolved.result, addr[nummember], attrs, false));
 				}
 			}
 
@@ -800,6 +804,13 @@ namespace ULR::Loader
 		
 		LoadedAssemblies[assembly->name] = assembly;
 
+		/* build member tables */
+
+		for (auto& entry : assembly->types)
+		{
+			entry.second->Seal(); // types deriving from a type in an assembly that is read but not loaded yet stay unsealed and are resolved by walking their hierarchy
+		}
+
 		/* populate vtables */
 
 		for (auto& entry : assembly->types)
@@ -809,6 +820,9 @@ namespace ULR::Loader
 
 		/* end vtable impl */
 
+		api->InvalidateCodeRanges();
+		api->RegisterStaticRoots(assembly);
+
 		void (*init_asm)(Resolver::ULRAPIImpl*) = (void (*)(Resolver::ULRAPIImpl*)) GetProcAddress(assembly->handle, "InitAssembly");
 
 		init_asm(api);
@@ -862,12 +876,9 @@ namespace ULR::Loader
 			return { placeholder, None };
 		}
 
-		for (const auto& entry: ReadAssemblies)
-		{
-			Assembly* assembly = entry.second;
+		auto found = TypeIndex.find(qual_name);
 
-			if (assembly->types.count(qual_name) == 1) return { assembly->types[qual_name], None };
-		}
+		if (found != TypeIndex.end()) return { found->second, None };
 
 
 		// if array type that is not already found, create it
@@ -891,8 +902,10 @@ namespace ULR::Loader
 			Type* array_type = new Type(TypeType::ArrayType, ArrayTypeAssembly, strdup(const_cast<const char*>(std::string(qual_name).c_str())), Modifiers::Public | Modifiers::Sealed, 0, { }, objecttype_resolved.result, elem_type);
 
 			PopulateVtable(array_type);
+			array_type->Seal();
 
 			ArrayTypeAssembly->types[array_type->name] = array_type; // use array_type->name because it is guaranteed to be dynamically allocated and last as long as array_type lasts
+			TypeIndex.emplace(array_type->name, array_type);
 
 			return { array_type, None };
 		}
@@ -948,9 +961,12 @@ namespace ULR::Loader
 			MethodInfo* impl = internal_api->GetNonNewMethod(type, info->name, info->argsig, BindingFlags::Public | BindingFlags::NonPublic | BindingFlags::Instance);
 
 			vtable[i] = impl->offset;
+
+			info->vtable_slot = (int) i; // bases come first, so the slot is the same in the vtables of derived types
 		}
 
 		type->primary_vtable = vtable;
+		type->primary_vtable_len = vfuncs.size();
 
 		/* End Primary Vtable */
 
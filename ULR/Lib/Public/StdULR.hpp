@@ -36,6 +36,19 @@ using sizeof_ns1_System_Boolean = bool;
 
 // End StackBox macro
 
+// Define a macro for the GC write barrier, which must follow every store of a reference into a heap object (so nursery collections can find old-to-young refs)
+// Nursery collections only run when the host enables them (ULR_GC_NURSERY=<size>), so a native assembly that misses a barrier is only unsafe under that setting
+
+#define ULR_WRITE_BARRIER(obj) internal_api->heap.WriteBarrier((char*) (obj))
+
+// End write barrier macro
+
+// Define a macro for safepoint polls, which long-running native loops should contain so that collections don't have to suspend their thread
+
+#define ULR_SAFEPOINT() internal_api->PollSafepoint()
+
+// End safepoint macro
+
 /*
 	This file includes the headers necessary for full ULR interaction. All ULR compilations should
 	include this header and accept a ULRAPIImpl* instance as an argument to their InitAssembly function.
@@ -1,10 +1,24 @@
 #include "Assembly.hpp"
+#include "Heap.hpp"
+#include "GCPolicy.hpp"
+#include "GCTelemetry.hpp"
+#include "AllocationProfiler.hpp"
+#include "HeapSnapshot.hpp"
+#include "GCHandles.hpp"
+#include "InvokeStubs.hpp"
+#include "Activator.hpp"
+#include "Delegate.hpp"
 #include <algorithm>
 #include <iostream>
 #include <type_traits>
 #include <set>
+#include <unordered_set>
+#include <deque>
 #include <thread>
 #include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <atomic>
 
 #pragma once
 
@@ -33,6 +47,42 @@ namespace ULR::Resolver
 		public:
 			size_t size_collected = 0;
 			size_t num_collected = 0;
+			bool nursery = false; // only young objects were collected
+			size_t num_finalizable = 0; // dead objects with a dtor, kept alive until the finalizer thread has run it
+			size_t pause_us = 0;
+	};
+
+	struct CodeRange
+	{
+		char* start;
+		char* end; // same as `start` when the size of the code is unknown (native methods), in which case only the start address resolves
+		MemberInfo* member;
+	};
+
+	// a static ref field, or a ref inside a static struct (which is stored inline, without a type ptr)
+	struct StaticRoot
+	{
+		char** slot;
+		FieldInfo* field; // for heap snapshots
+	};
+
+	// a thread whose stack is scanned for roots, registered by InitGCLocalVarRoot
+	struct ManagedThread
+	{
+		enum State
+		{
+			Running, // has to reach a safepoint before a collection can start
+			AtSafepoint, // parked until the collection is done
+			InNative // blocked outside of managed code (see EnterNative), may not touch the heap until LeaveNative
+		};
+
+		DWORD id;
+		HANDLE handle; // for suspending threads that don't reach a safepoint in time
+		char** stack_root; // highest scanned address
+		char** stack_end = nullptr; // lowest scanned address, published when the thread stops
+		std::atomic<int> state { Running };
+		bool suspended = false; // stopped by SuspendThread instead of at a safepoint
+		char* registers[16]; // register contents of a suspended thread, scanned like its stack
 	};
 
 	struct StaticDebugInfo
@@ -49,32 +99,149 @@ namespace ULR::Resolver
 		ULRResult<HMODULE> (*ReadAssemblyPtr)(const char name[]);
 		void (*StaticDebug)(StaticDebugInfo& info);
 
-		size_t prev_size_accessible = 0;
+		// stop-the-world: the collecting thread sets safepoint_requested and waits for every other registered thread to stop
+		std::vector<ManagedThread*> managed_threads;
+		std::mutex managed_threads_lock; // held by collections, so threads can't (un)register mid-collection
+		std::mutex safepoint_lock;
+		std::condition_variable safepoint_resume;
 
-		std::map<pthread_t, std::pair<char**, char**>> gc_lclsearch_addrs;
+		void StopManagedThreads(ManagedThread* self);
+		void ResumeManagedThreads(ManagedThread* self);
 
 		std::mutex gc_lock;
-		std::mutex alloc_lock;
+		std::shared_mutex method_cache_lock;
 		IL::JITContext* jit;
 
+		std::vector<CodeRange> code_ranges; // sorted by start address
+		bool code_ranges_dirty = true;
+		std::mutex code_ranges_lock;
+		std::once_flag symbols_initialized;
+		bool symbols_stale = false;
+
+		void BuildCodeRanges();
+		void RefreshSymbols(HANDLE proc);
+
+		// parallel marking, the collecting thread is worker 0 and the pool holds the others
+		std::vector<Heap::MarkDeque*> mark_deques; // one per worker
+		std::atomic<bool> mark_overflowed { false };
+		std::vector<std::thread> gc_workers;
+		unsigned int gc_worker_count = 0; // 0 means one worker per core
+		std::mutex gc_pool_lock;
+		std::condition_variable gc_pool_wake;
+		std::condition_variable gc_pool_done;
+		size_t gc_pool_epoch = 0; // bumped for every collection
+		unsigned int gc_pool_pending = 0;
+		bool gc_pool_stop = false;
+		std::mutex gc_map_lock;
+		size_t num_finalized_at_last_gc = 0; // for the per-collection telemetry
+
+		Heap::GCHandleTable gc_handles;
+
+		std::mutex activator_lock;
+
+		char* AllocateInstance(Activator* activator); // with its type set, not constructed yet
+
+		// static ref slots, found once per assembly when it is loaded so collections don't walk the types
+		std::map<Assembly*, std::vector<StaticRoot>> static_root_tables;
+		std::vector<StaticRoot> static_roots; // every table concatenated, rebuilt when an assembly is (un)registered
+
+		// root scanning tasks of the current collection
+		std::vector<std::pair<char**, char**>> gc_root_ranges;
+		size_t gc_num_root_tasks = 0;
+		std::atomic<size_t> gc_next_root_task { 0 };
+		std::atomic<size_t> gc_idle_workers { 0 };
+
+		// calls visit with the value of every ref field of obj (nulls included)
+		template <typename Visitor>
+		void VisitRefs(char* obj, Visitor visit)
+		{
+			Type* obj_type = GetTypeOf(obj);
+
+			if (!obj_type) return; // allocated, but not initialized yet
+
+			EnsureGCMap(obj_type);
+
+			if (obj_type->gc_ptr_offsets.empty()) return;
+
+			if (obj_type->decl_type == TypeType::ArrayType) // iterate through array elems so the GC can register them
+			{
+				size_t elem_size = obj_type->element_storage_size;
+
+				char* elems_ptr = (char*) ((int*) (((Type**) obj)+1)+1);
+
+				int len = *((int*) (((Type**) obj)+1));
+
+				char* elems_end = elems_ptr+((len)*elem_size);
+
+				for (; elems_ptr < elems_end; elems_ptr+=elem_size)
+				{
+					for (size_t offset : obj_type->gc_ptr_offsets) visit(*(char**) (elems_ptr+offset));
+				}
+
+				return;
+			}
+
+			for (size_t offset : obj_type->gc_ptr_offsets) visit(*(char**) (obj+offset));
+		}
+
+		void MarkObject(char* obj, Heap::MarkDeque& deque);
+		void ScanObject(char* obj, Heap::MarkDeque& deque);
+		void DrainMarkDeque(Heap::MarkDeque& deque);
+		void RunRootTask(size_t task, Heap::MarkDeque& deque);
+		void RunMarkWorker(unsigned int index);
+		void GCWorkerLoop(unsigned int index, size_t epoch);
+		void StopGCWorkers();
+		void MarkParallel(bool nursery);
+		void RescanOverflowedMarks();
+		size_t QueueFinalizers();
+		GCResult RunCollection(bool nursery, const std::function<void()>& while_stopped = nullptr); // while_stopped runs after the sweep, before the threads are resumed
+		void WriteSnapshotRecords(Heap::SnapshotWriter& writer);
+		bool PrepareAllocation(size_t size);
+
+		// dead objects whose type (or a base) has a dtor are found after marking and moved to finalizer_queue, however they were allocated
+		std::deque<char*> finalizer_queue;
+		std::unordered_set<char*> finalized_objs; // dtor already run, so they are freed the next time they are found dead (guarded by finalizer_lock)
+		std::mutex finalizer_lock;
+		std::recursive_mutex finalizer_busy; // held by the finalizer thread while it runs a dtor and by collections, recursive since dtors may collect
+		std::condition_variable finalizer_wake;
+		std::condition_variable finalizer_done;
+		std::thread finalizer_thread;
+		bool finalizer_stop = false;
+
+		void FinalizerLoop();
+
+		MethodInfo* LookupCachedMethod(Type* type, size_t hash, std::string_view name, Type* const* argsig, size_t nargs, int bindingflags, bool non_new);
+		void CacheMethod(Type* type, size_t hash, MethodInfo* method, int bindingflags, bool non_new);
+		MethodInfo* ResolveMethod(Type* type, std::string_view name, Type* const* argsig, size_t nargs, int bindingflags);
+		MethodInfo* ResolveNonNewMethod(Type* type, std::string_view name, Type* const* argsig, size_t nargs, int bindingflags);
+
 		public:
 			GCResult last_gc_result;
+			std::atomic<bool> safepoint_requested { false }; // polled by JIT code at calls and by allocations
+			std::atomic<size_t> finalizer_queue_length { 0 }; // dead objects waiting for their dtor
+			std::atomic<size_t> num_finalized { 0 }; // dtors run by the finalizer thread so far
 			void (*PopulateVtablePtr)(Type* type);
-			std::map<char*, size_t> allocated_objs;
-			size_t allocated_size = 0;
+			Heap::ManagedHeap heap;
+			Heap::GCPolicy* gc_policy; // configured from the environment (ULR_GC_*) at startup
+			Heap::GCTelemetry gc_telemetry; // a record of every recent collection and the pause time histograms, readable at any time
+			InvokeStubCache invoke_stubs; // for MethodInfo::Invoke and ConstructorInfo::Invoke
+			AllocationProfiler allocation_profiler; // disabled unless started (ulrhost starts it if ULR_ALLOC_PROFILE is set)
 			std::vector<void*> allocated_field_offsets;
 			std::map<std::string_view, Assembly*>* assemblies;
 			std::map<std::string_view, Assembly*>* read_assemblies;
+			std::unordered_map<std::string_view, Type*>* type_index; // every read type (native, JIT and array) keyed by its fully qualified name
 
 			ULRAPIImpl(
 				std::map<std::string_view, Assembly*>* assemblies,
 				std::map<std::string_view, Assembly*>* read_assemblies,
+				std::unordered_map<std::string_view, Type*>* type_index,
 				ULRResult<HMODULE> (*ReadAssembly)(const char name[]),
 				ULRResult<Assembly*> (*LoadAssembly)(const char name[], ULRAPIImpl* api),
 				void (*PopulateVtable)(Type* type),
 				HMODULE debugger,
 				bool& debugger_load_successful
 			);
+			~ULRAPIImpl();
 
 			bool EnsureLoaded(std::string_view assembly_name);
 			Assembly* LoadNativeAssembly(std::string_view assembly_name);
@@ -85,14 +252,17 @@ namespace ULR::Resolver
 			std::vector<MemberInfo*> GetMember(Type* type, std::string_view name);
 
 			ConstructorInfo* GetCtor(Type* type, std::vector<Type*> signature);
-			DestructorInfo* GetDtor(Type* type);
+			DestructorInfo* GetDtor(Type* type); // the dtor of the type or of its closest base that has one
 
-			MethodInfo* GetMethod(Type* type, std::string_view name, std::vector<Type*> argsignature, int bindingflags);
-			MethodInfo* GetMethod(Type* type, std::string_view name, std::vector<Type*> argsignature);
-			MethodInfo* GetNonNewMethod(Type* type, std::string_view name, std::vector<Type*> argsignature, int bindingflags); // this is solely for the virtual table loader
+			MethodInfo* GetMethod(Type* type, std::string_view name, const std::vector<Type*>& argsignature, int bindingflags);
+			MethodInfo* GetMethod(Type* type, std::string_view name, const std::vector<Type*>& argsignature);
+			MethodInfo* GetMethod(Type* type, std::string_view name, Type* const* argsig, size_t nargs, int bindingflags); // allocation-free overload, `argsig` points to `nargs` arg types
+			MethodInfo* GetNonNewMethod(Type* type, std::string_view name, const std::vector<Type*>& argsignature, int bindingflags); // this is solely for the virtual table loader
+			MethodInfo* GetNonNewMethod(Type* type, std::string_view name, Type* const* argsig, size_t nargs, int bindingflags);
 			FieldInfo* GetField(Type* type, std::string_view name, int bindingflags);
 			PropertyInfo* GetProperty(Type* type, std::string_view name, int bindingflags);
 			
+			void RegisterType(Type* type);
 			Type* GetArrayTypePrimarily(std::string_view full_qual_typename);
 			Type* GetType(std::string_view full_qual_typename);
 			Type* GetType(std::string_view full_qual_typename, std::string_view assembly_hint);
@@ -102,6 +272,18 @@ namespace ULR::Resolver
 			char* AllocateZeroed(size_t size);
 			char* AllocateObjectNoGC(size_t size);
 			char* AllocateZeroedNoGC(size_t size);
+			char* AllocateArray(Type* array_type, size_t length); // zeroed, with its type and length set
+			void EnsureGCMap(Type* type); // builds the type's gc_ptr_offsets if they aren't built yet, safe while collections are marking
+
+			// allocates and constructs an instance through the type's cached activator, nullptr if the type has no matching ctor (structs are returned boxed)
+			char* CreateInstance(Type* type);
+			char* CreateInstance(Type* type, Type* const* argsig, size_t nargs, void* const* args); // args as for ConstructorInfo::InvokeUnboxed
+			Activator* GetActivator(Type* type);
+
+			// see Delegate.hpp, nullptr for instance methods without a receiver (use CreateOpenDelegate) and generic methods
+			Delegate* CreateDelegate(MethodInfo* method, char* receiver = nullptr);
+			Delegate* CreateOpenDelegate(MethodInfo* method);
+			void FreeDelegate(Delegate* delegate);
 
 			void* AllocateFieldOffset(size_t size);
 			
@@ -123,16 +305,39 @@ namespace ULR::Resolver
 				return obj;
 			}
 
-			std::set<char*> ExamineRoot(char* root);
-			std::set<char*> ExamineRoots(std::set<char*> roots);
 			GCResult Collect();
-			void InitGCLocalVarRoot(char** stackaddr);
+			GCResult CollectNursery();
+			// runs a full collection and streams the surviving objects (with their refs) and the roots to path, see HeapSnapshot.hpp
+			bool WriteHeapSnapshot(const char* path);
+			void SetGCWorkerCount(unsigned int count); // takes effect at the next collection, 0 means one worker per core
+			void SetGCPolicy(Heap::GCPolicy* policy); // takes ownership
+			// for native code that keeps objects outside of the scanned stacks and statics, see GCHandles.hpp
+			Heap::GCHandle NewGCHandle(char* obj, Heap::GCHandleType type); // returns nullptr if the handle table is full
+			void FreeGCHandle(Heap::GCHandle handle);
+			char* GetGCHandleTarget(Heap::GCHandle handle); // nullptr once the target of a weak handle was collected
+			void SetGCHandleTarget(Heap::GCHandle handle, char* obj);
+			void WaitForPendingFinalizers();
+			void StopFinalizerThread(); // pending finalizers are dropped, like the objects left at exit
+			void InitGCLocalVarRoot(char** stackaddr); // registers the current thread
 			void InitGCLocalVarEnd(char** stackaddr);
+			void DetachThread(); // must be called by registered threads before they exit
+
+			// parks the current thread until the requested collection is done
+			void Safepoint();
+
+			inline void PollSafepoint()
+			{
+				if (safepoint_requested.load(std::memory_order_relaxed)) Safepoint();
+			}
+
+			// brackets blocking native code (waits, I/O), so that collections don't have to wait for (or suspend) the thread
+			void EnterNative();
+			void LeaveNative();
 
 			template <typename ValueType>
 			char* Box(ValueType& obj, Type* typeptr)
 			{
-				constexprsize_t alloc_size = sizeof(Type*)+sizeof(ValueType);
+				constexpr size_t alloc_size = sizeof(Type*)+sizeof(ValueType);
 
 				Type** boxed = (Type**) AllocateObject(alloc_size);
 
@@ -159,6 +364,10 @@ namespace ULR::Resolver
 
 			Assembly* ResolveAddressToAssembly(void* addr);
 			MemberInfo* ResolveAddressToMember(void* addr);
+			MemberInfo* ResolveReturnAddressToMember(void* addr); // any address inside a member's code (e.g. from a stack walk)
+			void InvalidateCodeRanges(); // must be called whenever code is added for a member (assembly loaded, JIT compilation finished)
+			void RegisterStaticRoots(Assembly* assembly); // must be called once the static fields of an assembly have their storage
+			void UnregisterStaticRoots(Assembly* assembly); // before the storage is freed
 			std::string GetFullyQualifiedNameOf(MemberInfo* type);
 			std::string GetDisplayNameOf(MemberInfo* member);
 			std::string GetDisplayNameOf(Type* member);
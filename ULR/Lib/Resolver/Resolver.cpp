@@ -4,6 +4,8 @@
 #include <winternl.h>
 #include <sstream>
 #include <fstream>
+#include <chrono>
+#include <climits>
 
 #define COLOR_INTEGER "\u001b[1m" // bold actually
 #define COLOR_TYPE_GREEN "\u001b[92m"
@@ -16,14 +18,19 @@ constexpr size_t operator"" _mb(size_t x) { return x*1000000; }
 constexpr size_t operator"" _gb(size_t x) { return x*1000_mb; }
 
 const size_t MAX_OBJECT_SIZE = 100_mb;
-const size_t GC_TRIGGER_SIZE = 2_gb;
 const size_t MAX_TRACEBACK = 30;
+const size_t ROOT_CHUNK_SLOTS = 4096; // stack slots per root scanning task
+const size_t ROOT_CHUNK_STATICS = 4096; // static ref slots per root scanning task
+const auto SAFEPOINT_TIMEOUT = std::chrono::microseconds(500); // threads that don't reach a safepoint within this are suspended
 
 namespace ULR::Resolver
 {
+	static thread_local ManagedThread* current_thread = nullptr;
+
 	ULRAPIImpl::ULRAPIImpl(
 		std::map<std::string_view, Assembly*>* assemblies,
 		std::map<std::string_view, Assembly*>* read_assemblies,
+		std::unordered_map<std::string_view, Type*>* type_index,
 		ULRResult<HMODULE> (*ReadAssembly)(const char name[]),
 		ULRResult<Assembly*> (*LoadAssembly)(const char name[], ULRAPIImpl* api),
 		void (*PopulateVtable)(Type* type),
@@ -33,10 +40,13 @@ namespace ULR::Resolver
 	{
 		this->assemblies = assemblies;
 		this->read_assemblies = read_assemblies;
+		this->type_index = type_index;
 		this->LoadAssemblyPtr = LoadAssembly;
 		this->ReadAssemblyPtr = ReadAssembly;
 		this->PopulateVtablePtr = PopulateVtable;
 		this->jit = new IL::JITContext(this);
+		this->gc_policy = Heap::CreateGCPolicy(Heap::ReadGCConfig());
+		this->gc_worker_count = gc_policy->config.workers;
 
 		if (debugger)
 		{
@@ -56,6 +66,14 @@ namespace ULR::Resolver
 		}
 	}
 
+	ULRAPIImpl::~ULRAPIImpl()
+	{
+		StopFinalizerThread();
+		StopGCWorkers();
+
+		delete gc_policy;
+	}
+
 	// returns true if the assembly is successfully loaded. returns false if the assembly was not read yet (and therefore cannot be loaded). If the assembly was read but not loaded, this function loads the assembly fully and returns true
 	bool ULRAPIImpl::EnsureLoaded(std::string_view assembly_name)
 	{
@@ -65,7 +83,7 @@ namespace ULR::Resolver
 		{
 			if (read_assemblies->count(assembly_name) == 0) return false;
 
-			LoadAssemblyPtr(namecpp.c_str(), this);
+			if (LoadAssemblyPtr(namecpp.c_str(), this).error != ULRInternalError::None) return false;
 		}
 
 		return true;
@@ -159,237 +177,261 @@ namespace ULR::Resolver
 		return addr;
 	}
 
+	// entries named `name` from the sealed member table, or collected into `scratch` by walking the hierarchy if the type has not been sealed yet
+	static std::pair<const MemberTableEntry*, const MemberTableEntry*> LookupMembers(Type* type, std::string_view name, std::vector<MemberTableEntry>& scratch)
+	{
+		if (type->sealed) return type->FindMembers(name);
+
+		type->CollectMembers(name, 0, scratch);
+
+		return { scratch.data(), scratch.data()+scratch.size() };
+	}
+
+	static bool MatchesBinding(const MemberTableEntry& entry, int bindingflags)
+	{
+		if (entry.is_static) return bindingflags & BindingFlags::Static;
+
+		return bindingflags & BindingFlags::Instance;
+	}
+
 	std::vector<MemberInfo*> ULRAPIImpl::GetMember(Type* type, std::string_view name)
 	{
+		std::vector<MemberTableEntry> scratch;
 		std::vector<MemberInfo*> matches;
 
-		if (type->static_attrs.count(name))
-			matches.insert(matches.begin(), type->static_attrs[name].begin(), type->static_attrs[name].end());
+		auto range = LookupMembers(type, name, scratch);
+
+		if (range.first == range.second) return matches;
+
+		unsigned int depth = range.first->depth; // members from the most derived type declaring `name` hide the ones further up
 
-		if (type->inst_attrs.count(name))
+		for (auto entry = range.first; entry != range.second && entry->depth == depth; entry++)
 		{
-			for (auto& to_add : type->inst_attrs[name])
-			{
-				matches.emplace_back(to_add);
-			}
+			if (entry->is_static) matches.emplace_back(entry->member);
 		}
 
-		if ((matches.size() == 0) && type->immediate_base) return GetMember(type->immediate_base, name);
+		for (auto entry = range.first; entry != range.second && entry->depth == depth; entry++)
+		{
+			if (!entry->is_static) matches.emplace_back(entry->member);
+		}
 
 		return matches;
 	}
 
 	ConstructorInfo* ULRAPIImpl::GetCtor(Type* type, std::vector<Type*> signature)
 	{
-		std::vector<MemberInfo*> ctors = type->static_attrs[".ctor"]; // types will always have a default ctor (even if they are static!!!) so there is no need to worry about accidentally creating an empty vector here
+		auto found = type->static_attrs.find(".ctor");
 
-		for (auto& ctor : ctors)
+		if (found == type->static_attrs.end()) return nullptr;
+
+		for (auto& ctor : found->second)
 		{
 			ConstructorInfo* casted = (ConstructorInfo*) ctor;
 
 			if (casted->argsig == signature) return casted;
 		}
 		
-		throw /* new NoConstructor exc*/;
+		return nullptr;
 	}
 
-	MethodInfo* ULRAPIImpl::GetMethod(Type* type, std::string_view name, std::vector<Type*> argsignature, int bindingflags)
+	// FNV-1a style mix of the name, the arg type pointers and the binding flags; nothing here allocates
+	static size_t HashMethodLookup(std::string_view name, Type* const* argsig, size_t nargs, int bindingflags)
 	{
-		if ((bindingflags & BindingFlags::Instance) && (type->inst_attrs.count(name)))
+		size_t hash = std::hash<std::string_view>()(name);
+
+		for (size_t i = 0; i < nargs; i++)
 		{
-			for (const auto member : type->inst_attrs[name])
-			{
-				if (member->decl_type == MemberType::Method)
-				{
-					MethodInfo* casted = (MethodInfo*) member;
+			hash ^= (size_t) argsig[i];
+			hash *= 0x100000001B3;
+		}
 
-					if (casted->argsig == argsignature)
-					{
-						if (member->attrs & Modifiers::Public)
-						{
-							if (bindingflags & BindingFlags::Public) return casted;
-						}
-						else if (bindingflags & BindingFlags::NonPublic) return casted;
+		return hash ^ (((size_t) bindingflags) << 56);
+	}
 
-						if (!(bindingflags & BindingFlags::Public) && !(bindingflags & BindingFlags::NonPublic)) return casted; // return the method if neither public nor nonpublic was specified
-					}
-				}
-			}
-		}
+	static bool SignatureMatches(MethodInfo* method, Type* const* argsig, size_t nargs)
+	{
+		return (method->argsig.size() == nargs) && std::equal(argsig, argsig+nargs, method->argsig.begin());
+	}
+
+	// the hash may collide, so every candidate is checked against the full lookup before it is returned
+	MethodInfo* ULRAPIImpl::LookupCachedMethod(Type* type, size_t hash, std::string_view name, Type* const* argsig, size_t nargs, int bindingflags, bool non_new)
+	{
+		std::shared_lock<std::shared_mutex> lock(method_cache_lock);
+
+		auto range = type->method_lookup_cache.equal_range(hash);
 
-		if ((bindingflags & BindingFlags::Static) && (type->static_attrs.count(name)))
+		for (auto it = range.first; it != range.second; it++)
 		{
-			for (const auto member : type->static_attrs[name])
-			{
-				if (member->decl_type == MemberType::Method)
-				{
-					MethodInfo* casted = (MethodInfo*) member;
+			MethodLookupEntry& entry = it->second;
 
-					if (casted->argsig == argsignature)
-					{
-						if (member->attrs & Modifiers::Public)
-						{
-							if (bindingflags & BindingFlags::Public) return casted;
-						}
-						else if (bindingflags & BindingFlags::NonPublic) return casted;
+			if (entry.bindingflags != bindingflags || entry.non_new != non_new) continue;
 
-						if (!(bindingflags & BindingFlags::Public) && !(bindingflags & BindingFlags::NonPublic)) return casted; // return the method if neither public nor nonpublic was specified
-					}
-				}
-			}
+			if (name == entry.method->name && SignatureMatches(entry.method, argsig, nargs)) return entry.method;
 		}
 
-		if (type->immediate_base) return GetMethod(type->immediate_base, name, argsignature, bindingflags);
-
 		return nullptr;
 	}
 
-	MethodInfo* ULRAPIImpl::GetMethod(Type* type, std::string_view name, std::vector<Type*> argsignature)
+	// only successful lookups are cached, since JIT types fill in their signatures after their methods are first declared
+	void ULRAPIImpl::CacheMethod(Type* type, size_t hash, MethodInfo* method, int bindingflags, bool non_new)
 	{
-		for (const auto member : type->inst_attrs[name])
-		{
-			if (member->decl_type == MemberType::Method)
-			{
-				MethodInfo* casted = (MethodInfo*) member;
+		std::unique_lock<std::shared_mutex> lock(method_cache_lock);
 
-				if (casted->argsig == argsignature) return casted;
-			}
-		}
+		type->method_lookup_cache.emplace(hash, MethodLookupEntry { bindingflags, non_new, method });
+	}
+
+	MethodInfo* ULRAPIImpl::ResolveMethod(Type* type, std::string_view name, Type* const* argsig, size_t nargs, int bindingflags)
+	{
+		std::vector<MemberTableEntry> scratch;
+
+		auto range = LookupMembers(type, name, scratch);
 
-		for (const auto member : type->static_attrs[name])
+		for (auto entry = range.first; entry != range.second; entry++)
 		{
-			if (member->decl_type == MemberType::Method)
+			MemberInfo* member = entry->member;
+
+			if (!MatchesBinding(*entry, bindingflags) || member->decl_type != MemberType::Method) continue;
+
+			MethodInfo* casted = (MethodInfo*) member;
+
+			if (SignatureMatches(casted, argsig, nargs))
 			{
-				MethodInfo* casted = (MethodInfo*) member;
+				if (member->attrs & Modifiers::Public)
+				{
+					if (bindingflags & BindingFlags::Public) return casted;
+				}
+				else if (bindingflags & BindingFlags::NonPublic) return casted;
 
-				if (casted->argsig == argsignature) return casted;
+				if (!(bindingflags & BindingFlags::Public) && !(bindingflags & BindingFlags::NonPublic)) return casted; // return the method if neither public nor nonpublic was specified
 			}
 		}
 
-		if (type->immediate_base) return GetMethod(type->immediate_base, name, argsignature);
-
 		return nullptr;
 	}
 
-	MethodInfo* ULRAPIImpl::GetNonNewMethod(Type* type, std::string_view name, std::vector<Type*> argsignature, int bindingflags)
+	MethodInfo* ULRAPIImpl::ResolveNonNewMethod(Type* type, std::string_view name, Type* const* argsig, size_t nargs, int bindingflags)
 	{
-		if ((bindingflags & BindingFlags::Instance) && (type->inst_attrs.count(name)))
+		std::vector<MemberTableEntry> scratch;
+
+		auto range = LookupMembers(type, name, scratch);
+
+		for (auto entry = range.first; entry != range.second; entry++)
 		{
-			for (const auto member : type->inst_attrs[name])
-			{
-				if (member->decl_type == MemberType::Method)
-				{
-					MethodInfo* casted = (MethodInfo*) member;
+			MemberInfo* member = entry->member;
 
-					if (casted->attrs & Modifiers::New && !(casted->attrs & Modifiers::Virtual)) continue;
+			if (!MatchesBinding(*entry, bindingflags) || member->decl_type != MemberType::Method) continue;
 
-					if (casted->argsig == argsignature)
-					{
-						if (member->attrs & Modifiers::Public)
-						{
-							if(bindingflags & BindingFlags::Public) return casted;
-						}
-						else if (bindingflags & BindingFlags::NonPublic) return casted;
-					}
-				}
-			}
-		}
+			MethodInfo* casted = (MethodInfo*) member;
 
-		if ((bindingflags & BindingFlags::Static) && (type->static_attrs.count(name)))
-		{
-			for (const auto member : type->static_attrs[name])
+			if (casted->attrs & Modifiers::New && !(casted->attrs & Modifiers::Virtual)) continue;
+
+			if (SignatureMatches(casted, argsig, nargs))
 			{
-				if (member->decl_type == MemberType::Method)
+				if (member->attrs & Modifiers::Public)
 				{
-					MethodInfo* casted = (MethodInfo*) member;
-
-					if (casted->attrs & Modifiers::New && !(casted->attrs & Modifiers::Virtual)) continue;
-
-					if (casted->argsig == argsignature)
-					{
-						if (member->attrs & Modifiers::Public)
-						{
-							if(bindingflags & BindingFlags::Public) return casted;
-						}
-						else if (bindingflags & BindingFlags::NonPublic) return casted;
-					}
+					if(bindingflags & BindingFlags::Public) return casted;
 				}
+				else if (bindingflags & BindingFlags::NonPublic) return casted;
 			}
 		}
 
-		if (type->immediate_base) return GetNonNewMethod(type->immediate_base, name, argsignature, bindingflags);
-
 		return nullptr;
 	}
 
+	MethodInfo* ULRAPIImpl::GetMethod(Type* type, std::string_view name, Type* const* argsig, size_t nargs, int bindingflags)
+	{
+		size_t hash = HashMethodLookup(name, argsig, nargs, bindingflags);
+
+		MethodInfo* method = LookupCachedMethod(type, hash, name, argsig, nargs, bindingflags, false);
+
+		if (method) return method;
+
+		method = ResolveMethod(type, name, argsig, nargs, bindingflags);
+
+		if (method) CacheMethod(type, hash, method, bindingflags, false);
+
+		return method;
+	}
+
+	MethodInfo* ULRAPIImpl::GetMethod(Type* type, std::string_view name, const std::vector<Type*>& argsignature, int bindingflags)
+	{
+		return GetMethod(type, name, argsignature.data(), argsignature.size(), bindingflags);
+	}
+
+	// searching both tables without any visibility flags matches any method with the right name & signature
+	MethodInfo* ULRAPIImpl::GetMethod(Type* type, std::string_view name, const std::vector<Type*>& argsignature)
+	{
+		return GetMethod(type, name, argsignature.data(), argsignature.size(), BindingFlags::Instance | BindingFlags::Static);
+	}
+
+	MethodInfo* ULRAPIImpl::GetNonNewMethod(Type* type, std::string_view name, Type* const* argsig, size_t nargs, int bindingflags)
+	{
+		size_t hash = HashMethodLookup(name, argsig, nargs, bindingflags);
+
+		MethodInfo* method = LookupCachedMethod(type, hash, name, argsig, nargs, bindingflags, true);
+
+		if (method) return method;
+
+		method = ResolveNonNewMethod(type, name, argsig, nargs, bindingflags);
+
+		if (method) CacheMethod(type, hash, method, bindingflags, true);
+
+		return method;
+	}
+
+	MethodInfo* ULRAPIImpl::GetNonNewMethod(Type* type, std::string_view name, const std::vector<Type*>& argsignature, int bindingflags)
+	{
+		return GetNonNewMethod(type, name, argsignature.data(), argsignature.size(), bindingflags);
+	}
+
 	FieldInfo* ULRAPIImpl::GetField(Type* type, std::string_view name, int bindingflags)
 	{
-		if ((bindingflags & BindingFlags::Instance) && (type->inst_attrs.count(name)))
-		{
-			for (const auto member : type->inst_attrs[name])
-			{
-				if (member->decl_type == MemberType::Field)
-				{
-					if (member->attrs & Modifiers::Public && bindingflags & BindingFlags::Public) return (FieldInfo*) member;
-					if (bindingflags & BindingFlags::NonPublic) return (FieldInfo*) member;
-				}
-			}
-		}
+		std::vector<MemberTableEntry> scratch;
+
+		auto range = LookupMembers(type, name, scratch);
 
-		if ((bindingflags & BindingFlags::Static) && (type->static_attrs.count(name)))
+		for (auto entry = range.first; entry != range.second; entry++)
 		{
-			for (const auto member : type->static_attrs[name])
-			{
-				if (member->decl_type == MemberType::Field)
-				{
-					if (member->attrs & Modifiers::Public && bindingflags & BindingFlags::Public) return (FieldInfo*) member;
-					if (bindingflags & BindingFlags::NonPublic) return (FieldInfo*) member;
-				}
-			}
-		}
+			MemberInfo* member = entry->member;
+
+			if (!MatchesBinding(*entry, bindingflags) || member->decl_type != MemberType::Field) continue;
 
-		if (type->immediate_base) return GetField(type->immediate_base, name, bindingflags);
+			if (member->attrs & Modifiers::Public && bindingflags & BindingFlags::Public) return (FieldInfo*) member;
+			if (bindingflags & BindingFlags::NonPublic) return (FieldInfo*) member;
+		}
 
 		return nullptr;	
 	}
 
 	PropertyInfo* ULRAPIImpl::GetProperty(Type* type, std::string_view name, int bindingflags)
 	{
-		if ((bindingflags & BindingFlags::Instance) && (type->inst_attrs.count(name)))
-		{
-			for (const auto member : type->inst_attrs[name])
-			{
-				if (member->decl_type == MemberType::Property)
-				{
-					if (member->attrs & Modifiers::Public && bindingflags & BindingFlags::Public) return (PropertyInfo*) member;
-					if (bindingflags & BindingFlags::NonPublic) return (PropertyInfo*) member;
-				}
-			}
-		}
+		std::vector<MemberTableEntry> scratch;
+
+		auto range = LookupMembers(type, name, scratch);
 
-		if ((bindingflags & BindingFlags::Static) && (type->static_attrs.count(name)))
+		for (auto entry = range.first; entry != range.second; entry++)
 		{
-			for (const auto member : type->static_attrs[name])
-			{
-				if (member->decl_type == MemberType::Property)
-				{
-					if (member->attrs & Modifiers::Public && bindingflags & BindingFlags::Public) return (PropertyInfo*) member;
-					if (bindingflags & BindingFlags::NonPublic) return (PropertyInfo*) member;
-				}
-			}
-		}
+			MemberInfo* member = entry->member;
+
+			if (!MatchesBinding(*entry, bindingflags) || member->decl_type != MemberType::Property) continue;
 
-		if (type->immediate_base) return GetProperty(type->immediate_base, name, bindingflags);
+			if (member->attrs & Modifiers::Public && bindingflags & BindingFlags::Public) return (PropertyInfo*) member;
+			if (bindingflags & BindingFlags::NonPublic) return (PropertyInfo*) member;
+		}
 
 		return nullptr;	
 	}
 
 	DestructorInfo* ULRAPIImpl::GetDtor(Type* type)
 	{
-		if (!type->static_attrs.count(".dtor")) return nullptr;
+		for (; type; type = type->immediate_base)
+		{
+			auto found = type->static_attrs.find(".dtor");
 
-		return (DestructorInfo*) (type->static_attrs[".dtor"][0]);
+			if (found != type->static_attrs.end()) return (DestructorInfo*) found->second[0];
+		}
 
+		return nullptr;
 	}
 
 	Type* ULRAPIImpl::GetArrayTypePrimarily(std::string_view full_qual_typename)
@@ -410,33 +452,36 @@ namespace ULR::Resolver
 			Type* array_type = new Type(TypeType::ArrayType, ArrayTypeAssembly, strdup(const_cast<const char*>(std::string(full_qual_typename).c_str())), Modifiers::Public | Modifiers::Sealed, 0, { }, GetType("[System]Object"), elem_type);
 
 			PopulateVtablePtr(array_type);
+			array_type->Seal();
 
 			ArrayTypeAssembly->types[array_type->name] = array_type; // use array_type->name because it is guaranteed to be dynamically allocated and last as long as array_type lasts
 
+			RegisterType(array_type);
+
 			return array_type;
 		}
 
 		return GetType(full_qual_typename); // it was not an array type
 	}
 
-	// }
-	Type* ULRAPIImpl::GetType(std::string_view full_qual_typename)
+	// the first type registered under a name wins, which matches the old behavior of returning the first match found while scanning the assembly maps
+	void ULRAPIImpl::RegisterType(Type* type)
 	{
-		for (auto& entry : *assemblies) // optimize this somehow
-		{
-			auto& assembly = entry.second;
+		type_index->emplace(type->name, type);
+	}
 
-			if (assembly->types.count(full_qual_typename) != 0) return assembly->types[full_qual_typename];
-		}
+	Type* ULRAPIImpl::GetType(std::string_view full_qual_typename)
+	{
+		auto found = type_index->find(full_qual_typename);
 
-		/* try to load assemblies until type is found */
-		for (auto& entry : *read_assemblies)
+		if (found != type_index->end())
 		{
-			if (assemblies->count(entry.first)) continue;
+			Type* type = found->second;
 
-			if (!EnsureLoaded(entry.first)) continue;
+			// types are indexed as soon as they are read, so make sure that the declaring assembly is loaded before handing the type out
+			if (type->assembly && !assemblies->count(type->assembly->name) && !EnsureLoaded(type->assembly->name)) return nullptr;
 
-			if (entry.second->types.count(full_qual_typename) != 0) return entry.second->types[full_qual_typename];
+			return type;
 		}
 
 
@@ -462,316 +507,1001 @@ namespace ULR::Resolver
 		return nullptr;
 	}
 	
-	char* ULRAPIImpl::AllocateObject(size_t size)
+	// runs the collection the policy asks for, returns false if the allocation would pass the heap limit even after collecting
+	bool ULRAPIImpl::PrepareAllocation(size_t size)
 	{
-		if ((allocated_size+size > GC_TRIGGER_SIZE) && (((allocated_size+size) - prev_size_accessible) > 10_mb))
-		{
-			char* framebase;
+		PollSafepoint(); // allocation is a safepoint
 
-			asm(
-				"mov %0, rbp\n\t"
-				:"=r"(framebase)
-			);
+		Heap::GCKind kind = gc_policy->OnAllocation(heap.allocated_size, heap.young_size, size);
 
-			// since framebase is the endpoint, if we don't add to the pointer to advance past it, it shouldn't be read by the GC (just saving one pointer deref for the GC)
+		if (kind == Heap::GCKind::None && !gc_policy->ExceedsLimit(heap.allocated_size, size)) return true;
 
-			internal_api->InitGCLocalVarEnd((char**) framebase);
+		char* framebase;
 
-			Collect();
-		}
+		asm(
+			"mov %0, rbp\n\t"
+			:"=r"(framebase)
+		);
+
+		// since framebase is the endpoint, if we don't add to the pointer to advance past it, it shouldn't be read by the GC (just saving one pointer deref for the GC)
+
+		InitGCLocalVarEnd((char**) framebase);
+
+		if (kind == Heap::GCKind::Nursery) CollectNursery();
+		else Collect();
+
+		if (!gc_policy->ExceedsLimit(heap.allocated_size, size)) return true;
+
+		// backpressure: the memory of objects waiting for their dtor is only released once the finalizer thread has run it
+		if (finalizer_queue_length && std::this_thread::get_id() != finalizer_thread.get_id()) WaitForPendingFinalizers();
+
+		Collect();
 
-		return AllocateObjectNoGC(size);
+		return !gc_policy->ExceedsLimit(heap.allocated_size, size);
 	}
 
-	char* ULRAPIImpl::AllocateZeroed(size_t size)
+	char* ULRAPIImpl::AllocateObject(size_t size)
 	{
-		if ((allocated_size+size > GC_TRIGGER_SIZE) && (((allocated_size+size) - prev_size_accessible) > 10_mb))
-		{
-			char* framebase;
+		if (!PrepareAllocation(size)) return nullptr; // TODO: have this throw a ULR exc
 
-			asm(
-				"mov %0, rbp\n\t"
-				:"=r"(framebase)
-			);
+		char* obj = AllocateObjectNoGC(size);
 
-			// since framebase is the endpoint, if we don't add to the pointer to advance past it, it shouldn't be read by the GC (just saving one pointer deref for the GC)
+		if (allocation_profiler.enabled.load(std::memory_order_relaxed) && obj) allocation_profiler.OnAllocation(obj, size);
 
-			internal_api->InitGCLocalVarEnd((char**) framebase);
+		return obj;
+	}
 
-			Collect();
-		}
+	char* ULRAPIImpl::AllocateZeroed(size_t size)
+	{
+		if (!PrepareAllocation(size)) return nullptr; // TODO: have this throw a ULR exc
 
-		return AllocateZeroedNoGC(size);
+		char* obj = AllocateZeroedNoGC(size);
+
+		if (allocation_profiler.enabled.load(std::memory_order_relaxed) && obj) allocation_profiler.OnAllocation(obj, size);
+
+		return obj;
 	}
 
 	char* ULRAPIImpl::AllocateObjectNoGC(size_t size)
 	{
-		alloc_lock.lock(); // another thread is GCing/allocating, don't interfere by allocating new objects (even though this is NoGC, that just means it won't trigger a collection, it still needs to be aware of the GC because it still emplaces objects)
+		if (size > MAX_OBJECT_SIZE) return nullptr; // TODO: have this throw a ULR exc
 
-		if (size > MAX_OBJECT_SIZE)
-		{
-			alloc_lock.unlock();
-			return nullptr; // TODO: have this throw a ULR exc
-		}
+		return heap.Allocate(size); // lock-free unless the thread's allocation buffer has to be refilled
+	}
+
+	char* ULRAPIImpl::AllocateZeroedNoGC(size_t size)
+	{
+		if (size > MAX_OBJECT_SIZE) return nullptr; // TODO: have this throw a ULR exc
 
-		char* mem = (char*) malloc(size);
+		return heap.AllocateZeroed(size);
+	}
+
+	char* ULRAPIImpl::AllocateArray(Type* array_type, size_t length)
+	{
+		size_t size = sizeof(Type*)+sizeof(int)+(length*array_type->element_storage_size);
+
+		if (length > INT_MAX || size > MAX_OBJECT_SIZE) return nullptr; // TODO: have this throw a ULR exc
 
-		allocated_objs.emplace(mem, size);
+		if (!PrepareAllocation(size)) return nullptr; // TODO: have this throw a ULR exc
 
-		allocated_size+=size;
+		char* arr = heap.AllocateZeroed(size); // big arrays go straight to their own pages, which the OS has already cleared
 
-		alloc_lock.unlock();
+		if (!arr) return nullptr;
 
-		return mem;
+		if (allocation_profiler.enabled.load(std::memory_order_relaxed)) allocation_profiler.OnAllocation(arr, size);
+
+		*(Type**) arr = array_type;
+		*(int*) (arr+sizeof(Type*)) = (int) length;
+
+		return arr;
 	}
 
-	char* ULRAPIImpl::AllocateZeroedNoGC(size_t size)
+	Activator* ULRAPIImpl::GetActivator(Type* type)
 	{
-		alloc_lock.lock(); // another thread is GCing/allocing, don't interfere by allocating new objects (even though this is NoGC, that just means it won't trigger a collection, it still needs to be aware of the GC because it still emplaces objects)
+		Activator* activator = type->activator.load(std::memory_order_acquire);
 
-		if (size > MAX_OBJECT_SIZE)
-		{
-			alloc_lock.unlock();
-			return nullptr; // TODO: have this throw a ULR exc
-		}
+		if (activator) return activator;
 
-		char* mem = (char*) calloc(size, 1);
+		std::lock_guard<std::mutex> guard(activator_lock);
 
-		allocated_objs.emplace(mem, size);
+		activator = type->activator.load(std::memory_order_relaxed);
 
-		allocated_size+=size;
+		if (!activator)
+		{
+			activator = new Activator(type);
 
-		alloc_lock.unlock();
-		
-		return mem;
+			type->activator.store(activator, std::memory_order_release);
+		}
+
+		return activator;
 	}
 
-	void* ULRAPIImpl::AllocateFieldOffset(size_t size)
+	char* ULRAPIImpl::AllocateInstance(Activator* activator)
 	{
-		void* alloced = malloc(size);
+		char* obj = activator->zero_init ? AllocateZeroed(activator->alloc_size) : AllocateObject(activator->alloc_size);
 
-		allocated_field_offsets.emplace_back(alloced);
+		if (!obj) return nullptr;
 
-		return alloced;
+		*(Type**) obj = activator->type;
+
+		return obj;
 	}
 
-	std::set<char*> ULRAPIImpl::ExamineRoot(char* root)
+	char* ULRAPIImpl::CreateInstance(Type* type)
 	{
-		std::set<char*> found = { root };
+		Activator* activator = GetActivator(type);
 
-		Type* root_type = GetTypeOf(root);
+		if (!activator->default_ctor) return nullptr;
 
-		if (root_type->decl_type == TypeType::ArrayType) // iterate through array elems so the GC can register them
-		{
-			if (IsBoxableStruct(root_type->element_type))
-			{
-				size_t elem_size = root_type->element_type->size;
-				
-				Type** stackboxbuf = (Type**) alloca(elem_size);
+		char* obj = AllocateInstance(activator);
 
-				stackboxbuf[0] = root_type->element_type;
+		if (!obj) return nullptr;
 
-				char* elems_ptr = (char*) ((int*) (((Type**) root)+1)+1);
+		activator->default_ctor(obj+activator->this_offset);
 
-				int len = *((int*) (((Type**) root)+1));
+		return obj;
+	}
 
-				char* elems_end = elems_ptr+((len)*elem_size);
+	char* ULRAPIImpl::CreateInstance(Type* type, Type* const* argsig, size_t nargs, void* const* args)
+	{
+		Activator* activator = GetActivator(type);
 
-				for (; elems_ptr < elems_end; elems_ptr+=elem_size)
-				{
-					memcpy(stackboxbuf+1, elems_ptr, elem_size);
+		if (!nargs && activator->default_ctor) return CreateInstance(type);
 
-					auto found_from_elem = ExamineRoot((char*) stackboxbuf);
+		ConstructorInfo* ctor = activator->FindCtor(argsig, nargs);
 
-					found.insert(found_from_elem.begin(), found_from_elem.end());
-				}
+		if (!ctor) return nullptr;
 
-				return found;
-			}
+		char* obj = AllocateInstance(activator);
 
-			size_t elem_size = sizeof(void*);
+		if (!obj) return nullptr;
 
-			char* elems_ptr = (char*) ((int*) (((Type**) root)+1)+1);
+		ctor->InvokeUnboxed(obj+activator->this_offset, args);
 
-			int len = *((int*) (((Type**) root)+1));
+		return obj;
+	}
 
-			char* elems_end = elems_ptr+((len)*elem_size);
+	Delegate* ULRAPIImpl::CreateDelegate(MethodInfo* method, char* receiver)
+	{
+		if (method->is_empty_generic || (!method->is_static && !receiver)) return nullptr;
 
-			for (; elems_ptr < elems_end; elems_ptr+=elem_size)
-			{
-				char* elem_obj = *(char**) elems_ptr;
+		Delegate* delegate = new Delegate();
 
-				auto found_from_elem = ExamineRoot(elem_obj);
+		delegate->method = method;
+		delegate->target = method->offset;
 
-				found.insert(found_from_elem.begin(), found_from_elem.end());
-			}
+		if (method->is_static) return delegate;
 
-			return found;			
-		}
+		delegate->receiver_handle = NewGCHandle(receiver, Heap::GCHandleType::Pinned);
 
-		for (auto& entry : root_type->inst_attrs)
+		if (!delegate->receiver_handle)
 		{
-			if (entry.second[0]->decl_type == MemberType::Field)
-			{
-				FieldInfo* field = (FieldInfo*) entry.second[0];
+			delete delegate;
+			return nullptr;
+		}
 
-				std::cout << GetDisplayNameOf(field) << std::endl;
+		delegate->is_virtual = method->attrs & Modifiers::Virtual;
+		delegate->this_offset = IsBoxableStruct(method->parent_type) ? sizeof(Type*) : 0;
+		delegate->target = delegate->TargetFor(receiver); // resolved once, calls go straight to the override
+		delegate->receiver = receiver+delegate->this_offset;
 
-				char* fieldval = field->GetValue(root);
+		return delegate;
+	}
 
-				if (found.count(fieldval)) continue; // prevent circular refs
+	Delegate* ULRAPIImpl::CreateOpenDelegate(MethodInfo* method)
+	{
+		if (method->is_empty_generic || method->is_static) return nullptr;
 
-				auto found_from_field = ExamineRoot(fieldval);
+		Delegate* delegate = new Delegate();
 
-				found.insert(found_from_field.begin(), found_from_field.end());	
-			}
-		}
+		delegate->method = method;
+		delegate->target = method->offset;
+		delegate->is_open = true;
+		delegate->is_virtual = method->attrs & Modifiers::Virtual;
+		delegate->this_offset = IsBoxableStruct(method->parent_type) ? sizeof(Type*) : 0;
 
-		return found;
+		return delegate;
 	}
 
-	std::set<char*> ULRAPIImpl::ExamineRoots(std::set<char*> roots)
+	void ULRAPIImpl::FreeDelegate(Delegate* delegate)
 	{
-		std::set<char*> total;
+		if (delegate->receiver_handle) FreeGCHandle(delegate->receiver_handle);
 
-		for (auto& root : roots)
-		{
-			if (total.count(root)) continue; // prevent circular refs
+		delete delegate;
+	}
 
-			auto found = ExamineRoot(root);
+	void* ULRAPIImpl::AllocateFieldOffset(size_t size)
+	{
+		void* alloced = malloc(size);
 
-			total.insert(found.begin(), found.end());	
-		}
+		allocated_field_offsets.emplace_back(alloced);
 
-		return total;
+		return alloced;
 	}
 
-	GCResult ULRAPIImpl::Collect()
+	void ULRAPIImpl::EnsureGCMap(Type* type)
 	{
-		if (!gc_lock.try_lock()) // another thread is already GCing, just exit
-			return { 0, 0 };
+		if (type->gc_map_built) return;
 
-		alloc_lock.lock(); // do not allow any allocation during collection
+		std::lock_guard<std::mutex> lock(gc_map_lock); // array types and generic constructions build their maps on first use, possibly on several workers at once
 
-		// TODO: get end addrs from all threads
+		type->BuildGCMap();
+	}
 
-		std::map<pthread_t, bool> doneflags;
+	void ULRAPIImpl::MarkObject(char* obj, Heap::MarkDeque& deque)
+	{
+		if (!heap.Mark(obj)) return; // not a heap object or already marked (circular refs)
 
-		for (auto& thread : gc_lclsearch_addrs)
-		{
-			if (thread.first == GetCurrentThreadId()) continue; // don't relog or suspend our thread
+		if (!deque.Push(obj)) mark_overflowed = true; // the object stays marked, its refs are picked up by the rescan in MarkParallel
+	}
 
-			HANDLE thread_handle = OpenThread(THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT, false, thread.first);
-			
-			CONTEXT threadctx;
-			
-			if (!GetThreadContext(thread_handle, &threadctx))
+	void ULRAPIImpl::ScanObject(char* obj, Heap::MarkDeque& deque)
+	{
+		VisitRefs(obj, [this, &deque](char* ref) { MarkObject(ref, deque); });
+	}
+
+	void ULRAPIImpl::DrainMarkDeque(Heap::MarkDeque& deque)
+	{
+		while (char* obj = deque.Pop()) ScanObject(obj, deque);
+	}
+
+	// tasks are numbered: stack chunks, then chunks of static ref slots, then the strong GC handles, then (for nursery collections) one per segment and one for the large objects
+	void ULRAPIImpl::RunRootTask(size_t task, Heap::MarkDeque& deque)
+	{
+		if (task < gc_root_ranges.size())
+		{
+			/*
+			if an allocated ptr is found on the stack, mark it as a root.
+			Note that this will also pickup integer and other valuetype data that looks like a valid pointer;
+			however, because of the unlikeliness of the situation and the fact that the runtime cleans up all 
+			allocations at the end of the program anyway, this issue will not be resolved at the moment since 
+			it shouldn't impact application behavior
+			*/
+			for (char** addr = gc_root_ranges[task].first; addr < gc_root_ranges[task].second; addr++)
 			{
-				abort(); // should be ULR exc later
-			}
+				char* candidate = *addr;
 
-			gc_lclsearch_addrs[thread.first].second = (char**) threadctx.Rsp; // register end of addressable stack for the thread
+				if (!heap.MayPointIntoHeap(candidate)) continue; // rejects most non-pointers with a few compares
 
-			SuspendThread(thread_handle);
+				// compiled code may only hold a ptr into the middle of an object (e.g. to a field or an array elem)
+				if (char* obj = heap.FindContainingObject(candidate)) MarkObject(obj, deque);
+			}
+
+			return;
 		}
 
-		std::set<char*> roots; // aggregate a list of all local var ptrs & static field vals
+		task-=gc_root_ranges.size();
 
-		for (auto& entry : gc_lclsearch_addrs) // search locals for all threads
+		size_t static_tasks = (static_roots.size()+ROOT_CHUNK_STATICS-1)/ROOT_CHUNK_STATICS;
+
+		if (task < static_tasks)
 		{
-			char** gc_lclsearch_begin = entry.second.first;
-			char** gc_lclsearch_end = entry.second.second;
+			size_t end = std::min((task+1)*ROOT_CHUNK_STATICS, static_roots.size());
 
-			// we have to start from the "end" and go to the beginning because the stack grows downward (the end is the smallest address)
-			for (char** addr = gc_lclsearch_end; addr < gc_lclsearch_begin; addr++)
-			{
-				/*
-				if an allocated ptr is found on the stack, mark it as a root.
-				Note that this will also pickup integer and other valuetype data that looks like a valid pointer;
-				however, because of the unlikeliness of the situation and the fact that the runtime cleans up all 
-				allocations at the end of the program anyway, this issue will not be resolved at the moment since 
-				it shouldn't impact application behavior
-				*/
-
-				if (allocated_objs.count(*addr)) roots.emplace(*addr);
-			}
+			for (size_t i = task*ROOT_CHUNK_STATICS; i < end; i++) MarkObject(*static_roots[i].slot, deque);
+
+			return;
 		}
 
-		for (auto& entry : *assemblies)
-		{
-			// add static roots to local var roots
-			for (auto& type_entry : entry.second->types)
-			{
-				for (auto& static_entry : type_entry.second->static_attrs)
-				{
-					if (static_entry.second[0]->decl_type == MemberType::Field)
-					{
-						char* fieldval = ((FieldInfo*) static_entry.second[0])->GetValue(nullptr);
+		task-=static_tasks;
 
-						// std::cout << (void*) fieldval << ' ' << GetDisplayNameOf(static_entry.second[0]) << std::endl;
+		if (task == 0)
+		{
+			gc_handles.ForEachStrong([this, &deque](char* obj) { MarkObject(obj, deque); });
 
-						roots.emplace(fieldval);
-					}
-				}
-			}
+			return;
 		}
 
-		std::set<char*> still_accessible = ExamineRoots(roots);
+		task--;
 
-		GCResult result;
+		// old objects stay marked during nursery collections, so only young ones are traced; old objects that were stored into since the last collection may be their only referrers
+		auto scan_old = [this, &deque](char* obj) { ScanObject(obj, deque); };
+
+		if (task < heap.NumSegments()) heap.ScanRememberedSegment(task, scan_old);
+		else heap.ScanRememberedLargeObjects(scan_old);
+	}
 
-		auto alloced_copy = allocated_objs;
+	void ULRAPIImpl::RunMarkWorker(unsigned int index)
+	{
+		Heap::MarkDeque& deque = *mark_deques[index];
 
-		for (auto& entry : alloced_copy)
+		for (size_t task = gc_next_root_task++; task < gc_num_root_tasks; task = gc_next_root_task++)
 		{
-			auto& alloced = entry.first;
+			RunRootTask(task, deque);
 
-			if (!still_accessible.count(alloced))
-			{
-				result.num_collected++;
-				result.size_collected+=entry.second;
-
-				Type* objtype = GetTypeOf(alloced);
-				
-				// call destructor before destroying obj
-				DestructorInfo* dtor = GetDtor(objtype);
-				if (dtor) dtor->Invoke(alloced); // only call dtor if it exists
-				
-				free(alloced);
-
-				allocated_objs.erase(alloced);
-			}
+			DrainMarkDeque(deque);
 		}
 
-		allocated_size-=result.size_collected;
+		size_t num_workers = mark_deques.size();
 
-		prev_size_accessible = allocated_size;
+		while (true)
+		{
+			DrainMarkDeque(deque);
 
-		last_gc_result = result;
+			char* stolen = nullptr;
 
-		gc_lock.unlock();
-		alloc_lock.unlock();
+			for (size_t victim = 1; victim < num_workers && !stolen; victim++) stolen = mark_deques[(index+victim) % num_workers]->Steal();
+
+			if (stolen)
+			{
+				ScanObject(stolen, deque);
+				continue;
+			}
+
+			// a worker only goes idle with an empty deque and only idle workers push nothing, so once every worker is idle, marking is done
+			gc_idle_workers++;
+
+			while (true)
+			{
+				if (gc_idle_workers == num_workers) return;
+
+				bool work_left = false;
+
+				for (auto other : mark_deques) work_left = work_left || !other->Empty();
+
+				if (work_left)
+				{
+					gc_idle_workers--;
+					break;
+				}
 
-		for (auto& thread : gc_lclsearch_addrs) // restart all other threads
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	void ULRAPIImpl::GCWorkerLoop(unsigned int index, size_t epoch)
+	{
+		while (true)
 		{
-			if (thread.first == GetCurrentThreadId()) continue; // our thread is already running!
+			{
+				std::unique_lock<std::mutex> lock(gc_pool_lock);
 
-			HANDLE thread_handle = OpenThread(THREAD_SUSPEND_RESUME, false, thread.first);
-			
-			ResumeThread(thread_handle);
+				gc_pool_wake.wait(lock, [this, epoch]() { return gc_pool_stop || gc_pool_epoch != epoch; });
+
+				if (gc_pool_stop) return;
+
+				epoch = gc_pool_epoch;
+			}
+
+			RunMarkWorker(index);
+
+			std::lock_guard<std::mutex> lock(gc_pool_lock);
+
+			if (--gc_pool_pending == 0) gc_pool_done.notify_all();
+		}
+	}
+
+	void ULRAPIImpl::StopGCWorkers()
+	{
+		{
+			std::lock_guard<std::mutex> lock(gc_pool_lock);
+
+			gc_pool_stop = true;
+		}
+
+		gc_pool_wake.notify_all();
+
+		for (auto& worker : gc_workers) worker.join();
+
+		gc_workers.clear();
+
+		for (auto deque : mark_deques) delete deque;
+
+		mark_deques.clear();
+
+		gc_pool_stop = false;
+	}
+
+	void ULRAPIImpl::SetGCWorkerCount(unsigned int count)
+	{
+		gc_worker_count = count;
+	}
+
+	void ULRAPIImpl::SetGCPolicy(Heap::GCPolicy* policy)
+	{
+		std::lock_guard<std::mutex> lock(gc_lock); // not mid-collection
+
+		delete gc_policy;
+
+		gc_policy = policy;
+	}
+
+	void ULRAPIImpl::MarkParallel(bool nursery)
+	{
+		unsigned int num_workers = gc_worker_count ? gc_worker_count : std::max(std::thread::hardware_concurrency(), 1u);
+
+		if (num_workers != mark_deques.size()) // (re)start the pool, the collecting thread is worker 0
+		{
+			StopGCWorkers();
+
+			for (unsigned int i = 0; i < num_workers; i++) mark_deques.push_back(new Heap::MarkDeque());
+
+			for (unsigned int i = 1; i < num_workers; i++) gc_workers.emplace_back(&ULRAPIImpl::GCWorkerLoop, this, i, gc_pool_epoch);
+		}
+
+		// partition the roots
+		gc_root_ranges.clear();
+
+		for (ManagedThread* thread : managed_threads) // search locals for all threads
+		{
+			if (!thread->stack_end) continue; // hasn't run anything yet
+
+			// we have to start from the "end" and go to the beginning because the stack grows downward (the end is the smallest address)
+			for (char** chunk = thread->stack_end; chunk < thread->stack_root; chunk+=ROOT_CHUNK_SLOTS)
+			{
+				gc_root_ranges.emplace_back(chunk, std::min(chunk+ROOT_CHUNK_SLOTS, thread->stack_root));
+			}
+
+			if (thread->suspended) gc_root_ranges.emplace_back(thread->registers, thread->registers+16);
+		}
+
+		gc_num_root_tasks = gc_root_ranges.size()+((static_roots.size()+ROOT_CHUNK_STATICS-1)/ROOT_CHUNK_STATICS)+1;
+
+		heap.FinishSweep(); // dead objects left by the last collection must not be found (and marked) through stale refs
+
+		if (nursery) gc_num_root_tasks+=heap.NumSegments()+1;
+		else heap.ClearMarks();
+
+		gc_next_root_task = 0;
+		gc_idle_workers = 0;
+		mark_overflowed = false;
+
+		for (char* obj : finalizer_queue) MarkObject(obj, *mark_deques[0]); // waiting for their dtor
+
+		{
+			std::lock_guard<std::mutex> lock(gc_pool_lock);
+
+			gc_pool_pending = gc_workers.size();
+			gc_pool_epoch++;
+		}
+
+		gc_pool_wake.notify_all();
+
+		RunMarkWorker(0);
+
+		{
+			std::unique_lock<std::mutex> lock(gc_pool_lock);
+
+			gc_pool_done.wait(lock, [this]() { return gc_pool_pending == 0; });
+		}
+
+		RescanOverflowedMarks();
+	}
+
+	void ULRAPIImpl::RescanOverflowedMarks()
+	{
+		// objects that were marked while their worker's deque was full haven't been scanned yet; scanning every marked object again finds them (and only pushes unmarked refs)
+		while (mark_overflowed)
+		{
+			mark_overflowed = false;
+
+			heap.ForEachMarkedObject([this](char* obj) {
+				ScanObject(obj, *mark_deques[0]);
+
+				DrainMarkDeque(*mark_deques[0]);
+			});
+		}
+	}
+
+	// moves the unreachable objects with a dtor to the finalizer queue and marks everything they reference, returns the number of objects queued
+	size_t ULRAPIImpl::QueueFinalizers()
+	{
+		std::lock_guard<std::mutex> queue_lock(finalizer_lock);
+
+		std::unordered_map<Type*, bool> has_dtor; // most dead objects share a few types, so the hierarchy is only walked once per type
+		std::vector<char*> dead_finalizable;
+
+		// unmarked objects are exactly the ones the sweep frees (young ones only during a nursery collection, see ClearMarks)
+		heap.ForEachUnmarkedObject([this, &has_dtor, &dead_finalizable](char* obj) {
+			Type* type = GetTypeOf(obj);
+
+			if (!type) return; // allocated, but not initialized yet
+
+			auto found = has_dtor.find(type);
+
+			if (found == has_dtor.end()) found = has_dtor.emplace(type, GetDtor(type) != nullptr).first;
+
+			if (found->second) dead_finalizable.push_back(obj);
+		});
+
+		size_t num_queued = 0;
+
+		for (char* obj : dead_finalizable)
+		{
+			if (finalized_objs.count(obj)) continue; // its dtor has run, so it is freed this time
+
+			heap.Mark(obj);
+
+			finalizer_queue.push_back(obj);
+			num_queued++;
+
+			if (!mark_deques[0]->Push(obj)) mark_overflowed = true;
+		}
+
+		DrainMarkDeque(*mark_deques[0]);
+		RescanOverflowedMarks();
+
+		// a finalized object that a queued one references stays alive (and finalized), the others are swept now
+		for (char* obj : dead_finalizable)
+		{
+			if (!heap.IsMarked(obj)) finalized_objs.erase(obj);
+		}
+
+		finalizer_queue_length+=num_queued;
+
+		return num_queued;
+	}
+
+	Heap::GCHandle ULRAPIImpl::NewGCHandle(char* obj, Heap::GCHandleType type)
+	{
+		return gc_handles.Alloc(obj, type);
+	}
+
+	void ULRAPIImpl::FreeGCHandle(Heap::GCHandle handle)
+	{
+		gc_handles.Free(handle);
+	}
+
+	char* ULRAPIImpl::GetGCHandleTarget(Heap::GCHandle handle)
+	{
+		return gc_handles.Get(handle);
+	}
+
+	void ULRAPIImpl::SetGCHandleTarget(Heap::GCHandle handle, char* obj)
+	{
+		gc_handles.Set(handle, obj); // handles are scanned by every collection, so no write barrier
+	}
+
+	void ULRAPIImpl::FinalizerLoop()
+	{
+		char* framebase;
+
+		asm(
+			"mov %0, rbp\n\t"
+			:"=r"(framebase)
+		);
+
+		InitGCLocalVarRoot((char**) framebase); // dtors may allocate (and collect)
+
+		while (true)
+		{
+			EnterNative(); // idle, collections don't wait for this thread
+
+			std::unique_lock<std::mutex> lock(finalizer_lock);
+
+			finalizer_wake.wait(lock, [this]() { return finalizer_stop || !finalizer_queue.empty(); });
+
+			lock.unlock();
+
+			// collections wait for the running dtor, so they never see an object that is neither queued nor on this stack
+			std::unique_lock<std::recursive_mutex> busy(finalizer_busy);
+
+			LeaveNative();
+
+			lock.lock();
+
+			if (finalizer_stop) break;
+
+			if (finalizer_queue.empty()) continue; // dropped by StopFinalizerThread
+
+			char* obj = finalizer_queue.front();
+
+			finalizer_queue.pop_front();
+
+			lock.unlock();
+
+			GetDtor(GetTypeOf(obj))->Invoke(obj); // the object stays marked (old) until a full collection finds it dead again
+
+			num_finalized++;
+
+			lock.lock();
+
+			finalized_objs.insert(obj);
+
+			finalizer_queue_length--;
+
+			lock.unlock();
+
+			finalizer_done.notify_all();
+		}
+
+		DetachThread();
+	}
+
+	void ULRAPIImpl::WaitForPendingFinalizers()
+	{
+		EnterNative();
+
+		{
+			std::unique_lock<std::mutex> lock(finalizer_lock);
+
+			finalizer_done.wait(lock, [this]() { return finalizer_queue_length == 0; });
+		}
+
+		LeaveNative();
+	}
+
+	void ULRAPIImpl::StopFinalizerThread()
+	{
+		{
+			std::lock_guard<std::mutex> lock(finalizer_lock);
+
+			finalizer_stop = true;
+
+			finalizer_queue.clear();
+			finalizer_queue_length = 0;
+		}
+
+		finalizer_wake.notify_all();
+		finalizer_done.notify_all();
+
+		if (finalizer_thread.joinable()) finalizer_thread.join();
+
+		finalizer_stop = false;
+	}
+
+	GCResult ULRAPIImpl::Collect()
+	{
+		return RunCollection(false);
+	}
+
+	GCResult ULRAPIImpl::CollectNursery()
+	{
+		return RunCollection(true);
+	}
+
+	GCResult ULRAPIImpl::RunCollection(bool nursery, const std::function<void()>& while_stopped)
+	{
+		if (!gc_lock.try_lock()) // another thread is already GCing, wait for it to finish and exit
+		{
+			Safepoint();
+
+			return { 0, 0 };
+		}
+
+		std::lock_guard<std::recursive_mutex> finalizer_paused(finalizer_busy); // let the running dtor finish before stopping the finalizer thread
+		std::lock_guard<std::mutex> threads_lock(managed_threads_lock);
+		// held through the pause, so no thread can be suspended inside the allocator while holding it (the sweep takes it while the world is stopped)
+		std::lock_guard<std::recursive_mutex> heap_locked(heap.heap_lock);
+		std::unique_lock<std::mutex> profile_locked = allocation_profiler.LockForCollection(); // same for the allocation profiler's samples
+
+		auto pause_start = std::chrono::steady_clock::now();
+
+		Heap::GCEvent event = { };
+
+		event.nursery = nursery;
+		event.start_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(pause_start.time_since_epoch()).count();
+		event.num_threads = managed_threads.size();
+		event.num_finalized = num_finalized-num_finalized_at_last_gc;
+
+		num_finalized_at_last_gc+=event.num_finalized;
+
+		ManagedThread* self = current_thread;
+
+		StopManagedThreads(self);
+
+		// sampled objects have to be attributed to their type before a sweep lets their cells be reused
+		allocation_profiler.OnCollection(); // even when disabled, Stop may have raced with a sample
+
+		auto stopped = std::chrono::steady_clock::now();
+
+		event.heap_size_before = heap.allocated_size;
+		event.young_size_before = heap.young_size;
+
+		MarkParallel(nursery);
+
+		auto marked = std::chrono::steady_clock::now();
+
+		event.num_workers = mark_deques.size(); // the pool is created (or resized) by MarkParallel
+
+		for (auto& range : gc_root_ranges) event.stack_slots_scanned+=range.second-range.first;
+
+		event.static_roots_scanned = static_roots.size();
+		event.num_handles = gc_handles.num_handles;
+
+		// weak handles don't see objects that are only kept alive for their dtor
+		event.num_weak_handles_cleared = gc_handles.ClearDeadWeak([this](char* obj) { return heap.IsMarked(obj); });
+
+		GCResult result;
+
+		result.nursery = nursery;
+
+		result.num_finalizable = QueueFinalizers();
+
+		auto finalizers_queued = std::chrono::steady_clock::now();
+
+		// only the counts are taken here, dead objects are reclaimed as allocation needs their segments
+		Heap::SweepStats stats = heap.BeginSweep();
+
+		result.num_collected = stats.num_dead;
+		result.size_collected = stats.dead_size;
+
+		auto pause_end = std::chrono::steady_clock::now();
+
+		result.pause_us = std::chrono::duration_cast<std::chrono::microseconds>(pause_end-pause_start).count();
+
+		gc_policy->OnCollection(nursery, event.heap_size_before, heap.allocated_size, result.pause_us);
+
+		event.end_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(pause_end.time_since_epoch()).count();
+		event.stop_us = std::chrono::duration_cast<std::chrono::microseconds>(stopped-pause_start).count();
+		event.mark_us = std::chrono::duration_cast<std::chrono::microseconds>(marked-stopped).count();
+		event.finalize_us = std::chrono::duration_cast<std::chrono::microseconds>(finalizers_queued-marked).count();
+		event.sweep_us = std::chrono::duration_cast<std::chrono::microseconds>(pause_end-finalizers_queued).count();
+		event.pause_us = result.pause_us;
+		event.heap_size_after = heap.allocated_size;
+		// a nursery collection keeps every old object, so whatever it didn't collect out of the young bytes survived
+		event.promoted_size = nursery ? (event.young_size_before-std::min(event.young_size_before, stats.dead_size)) : 0;
+		event.num_collected = stats.num_dead;
+		event.size_collected = stats.dead_size;
+		event.num_queued_for_finalization = result.num_finalizable;
+
+		gc_telemetry.Record(event);
+
+		last_gc_result = result;
+
+		if (while_stopped) while_stopped();
+
+		if (result.num_finalizable)
+		{
+			if (!finalizer_thread.joinable()) finalizer_thread = std::thread(&ULRAPIImpl::FinalizerLoop, this);
+
+			finalizer_wake.notify_one();
 		}
 
+		gc_lock.unlock();
+
+		ResumeManagedThreads(self);
+
 		return result;
 	}
 
+	bool ULRAPIImpl::WriteHeapSnapshot(const char* path)
+	{
+		Heap::SnapshotWriter writer;
+
+		if (!writer.Open(path)) return false;
+
+		bool written = false;
+
+		// a collection that was already running is waited for without calling back, so try again
+		while (!written) RunCollection(false, [this, &writer, &written]() {
+			WriteSnapshotRecords(writer);
+
+			written = true;
+		});
+
+		return writer.Close();
+	}
+
+	// the world is stopped and the sweep has left only the survivors marked
+	void ULRAPIImpl::WriteSnapshotRecords(Heap::SnapshotWriter& writer)
+	{
+		std::unordered_map<Type*, uint64_t> type_ids;
+		std::vector<char*> refs;
+
+		heap.ForEachMarkedObject([this, &writer, &type_ids, &refs](char* obj) {
+			Type* type = GetTypeOf(obj);
+			uint64_t type_id = 0;
+
+			if (type)
+			{
+				auto found = type_ids.emplace(type, type_ids.size()+1);
+
+				if (found.second) writer.WriteType(found.first->second, GetDisplayNameOf(type));
+
+				type_id = found.first->second;
+			}
+
+			refs.clear();
+
+			VisitRefs(obj, [this, &refs](char* ref) {
+				if (heap.FindObject(ref)) refs.push_back(ref);
+			});
+
+			writer.WriteObject(obj, type_id, heap.SizeOf(obj), refs);
+		});
+
+		// the roots of the full collection that just ran
+		for (auto& range : gc_root_ranges)
+		{
+			for (char** addr = range.first; addr < range.second; addr++)
+			{
+				if (!heap.MayPointIntoHeap(*addr)) continue;
+
+				if (char* obj = heap.FindContainingObject(*addr)) writer.WriteRoot(Heap::RootKind::Stack, obj, "");
+			}
+		}
+
+		FieldInfo* named_field = nullptr;
+		std::string name;
+
+		for (StaticRoot& root : static_roots)
+		{
+			if (!heap.FindObject(*root.slot)) continue;
+
+			if (root.field != named_field) // slots of one field are adjacent
+			{
+				named_field = root.field;
+				name = GetFullyQualifiedNameOf(named_field);
+			}
+
+			writer.WriteRoot(Heap::RootKind::Static, *root.slot, name);
+		}
+
+		gc_handles.ForEachStrong([this, &writer](char* obj) {
+			if (heap.FindObject(obj)) writer.WriteRoot(Heap::RootKind::Handle, obj, "");
+		});
+
+		std::lock_guard<std::mutex> lock(finalizer_lock);
+
+		for (char* obj : finalizer_queue) writer.WriteRoot(Heap::RootKind::Finalizer, obj, "");
+	}
+
+	void ULRAPIImpl::StopManagedThreads(ManagedThread* self)
+	{
+		safepoint_requested = true;
+
+		auto deadline = std::chrono::steady_clock::now()+SAFEPOINT_TIMEOUT;
+
+		for (ManagedThread* thread : managed_threads)
+		{
+			if (thread == self) continue;
+
+			while (thread->state == ManagedThread::Running && std::chrono::steady_clock::now() < deadline) std::this_thread::yield();
+
+			if (thread->state != ManagedThread::Running) continue; // stopped itself and published its stack end
+
+			// stuck in native code without polls; SuspendThread is asynchronous, GetThreadContext only returns once the thread has actually stopped
+			if (SuspendThread(thread->handle) == (DWORD) -1) continue; // exited without detaching
+
+			CONTEXT threadctx;
+
+			threadctx.ContextFlags = CONTEXT_CONTROL | CONTEXT_INTEGER;
+
+			if (!GetThreadContext(thread->handle, &threadctx))
+			{
+				abort(); // should be ULR exc later
+			}
+
+			thread->suspended = true;
+			thread->stack_end = (char**) threadctx.Rsp; // register end of addressable stack for the thread
+
+			DWORD64 registers[16] = {
+				threadctx.Rax, threadctx.Rcx, threadctx.Rdx, threadctx.Rbx, threadctx.Rsp, threadctx.Rbp, threadctx.Rsi, threadctx.Rdi,
+				threadctx.R8, threadctx.R9, threadctx.R10, threadctx.R11, threadctx.R12, threadctx.R13, threadctx.R14, threadctx.R15
+			};
+
+			memcpy(thread->registers, registers, sizeof(registers));
+		}
+	}
+
+	void ULRAPIImpl::ResumeManagedThreads(ManagedThread* self)
+	{
+		// resume suspended threads first, one may have been stopped while holding safepoint_lock
+		for (ManagedThread* thread : managed_threads)
+		{
+			if (!thread->suspended) continue;
+
+			thread->suspended = false;
+
+			ResumeThread(thread->handle);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(safepoint_lock);
+
+			safepoint_requested = false;
+		}
+
+		safepoint_resume.notify_all();
+	}
+
+	void ULRAPIImpl::Safepoint()
+	{
+		ManagedThread* self = current_thread;
+
+		if (!self) return; // unregistered threads aren't scanned, so they don't stop either
+
+		char* stack_end;
+
+		__builtin_unwind_init(); // spills the callee-saved registers into this frame, so refs held in them are scanned too
+
+		asm(
+			"mov %0, rsp\n\t"
+			:"=r"(stack_end)
+		);
+
+		self->stack_end = (char**) stack_end;
+
+		std::unique_lock<std::mutex> lock(safepoint_lock);
+
+		self->state = ManagedThread::AtSafepoint;
+
+		safepoint_resume.wait(lock, [this]() { return !safepoint_requested; });
+
+		self->state = ManagedThread::Running;
+	}
+
+	void ULRAPIImpl::EnterNative()
+	{
+		ManagedThread* self = current_thread;
+
+		if (!self) return;
+
+		char* stack_end;
+
+		__builtin_unwind_init();
+
+		asm(
+			"mov %0, rsp\n\t"
+			:"=r"(stack_end)
+		);
+
+		self->stack_end = (char**) stack_end;
+		self->state = ManagedThread::InNative;
+	}
+
+	void ULRAPIImpl::LeaveNative()
+	{
+		ManagedThread* self = current_thread;
+
+		if (!self) return;
+
+		while (true)
+		{
+			self->state = ManagedThread::Running;
+
+			// a collection that started before the state change may have seen this thread in native code and be scanning its stack already
+			if (!safepoint_requested) return;
+
+			self->state = ManagedThread::InNative;
+
+			std::unique_lock<std::mutex> lock(safepoint_lock);
+
+			safepoint_resume.wait(lock, [this]() { return !safepoint_requested; });
+		}
+	}
+
 	void ULRAPIImpl::InitGCLocalVarRoot(char** stackaddr)
 	{
-		gc_lclsearch_addrs[GetCurrentThreadId()].first = stackaddr;
+		PollSafepoint(); // a collection holds managed_threads_lock while it waits for registered threads
+
+		std::lock_guard<std::mutex> lock(managed_threads_lock);
+
+		if (!current_thread)
+		{
+			current_thread = new ManagedThread();
+
+			current_thread->id = GetCurrentThreadId();
+			current_thread->handle = OpenThread(THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT, false, current_thread->id);
+
+			managed_threads.push_back(current_thread);
+		}
+
+		current_thread->stack_root = stackaddr;
 	}
 
 	void ULRAPIImpl::InitGCLocalVarEnd(char** stackaddr)
 	{
-		gc_lclsearch_addrs[GetCurrentThreadId()].second = stackaddr;
+		if (current_thread) current_thread->stack_end = stackaddr;
+	}
+
+	void ULRAPIImpl::DetachThread()
+	{
+		if (!current_thread) return;
+
+		PollSafepoint();
+
+		std::lock_guard<std::mutex> lock(managed_threads_lock);
+
+		managed_threads.erase(std::find(managed_threads.begin(), managed_threads.end(), current_thread));
+
+		CloseHandle(current_thread->handle);
+
+		delete current_thread;
+
+		current_thread = nullptr;
 	}
 
 	void ULRAPIImpl::Breakpoint(StaticDebugInfo info)
@@ -797,45 +1527,164 @@ namespace ULR::Resolver
 		return nullptr;
 	}
 
-	MemberInfo* ULRAPIImpl::ResolveAddressToMember(void* addr)
+	static void AddCodeRange(std::vector<CodeRange>& ranges, void* start, MemberInfo* member)
 	{
+		if (start) ranges.push_back({ (char*) start, (char*) start, member });
+	}
+
+	void ULRAPIImpl::BuildCodeRanges()
+	{
+		std::vector<CodeRange> ranges;
+
 		for (auto& entry : *assemblies)
 		{
-			for (auto& type_entry : entry.second->types)
+			Assembly* assembly = entry.second;
+
+			if (assembly->jit_info) // JIT compiled code knows its size, so the whole range can be resolved (there are no symbols for it anyway)
 			{
-				for (const auto member_entry : type_entry.second->inst_attrs)
+				for (auto& method : assembly->jit_info->methods)
+				{
+					ranges.push_back({ (char*) method.addr, ((char*) method.addr)+method.size, method.member });
+				}
+
+				continue;
+			}
+
+			for (auto& type_entry : assembly->types)
+			{
+				for (auto& member_entry : type_entry.second->inst_attrs)
 				{
-					if (
-						member_entry.second[0]->decl_type == MemberType::Field ||
-						member_entry.second[0]->decl_type == MemberType::Property)
-							continue;
-					
 					for (const auto member : member_entry.second)
 					{
-						if (member->decl_type == MemberType::Method && ((MethodInfo*) member)->offset == addr) return member;
+						if (member->decl_type == MemberType::Method) AddCodeRange(ranges, ((MethodInfo*) member)->offset, member);
 					}
 				}
 
-				for (const auto member_entry : type_entry.second->static_attrs)
+				for (auto& member_entry : type_entry.second->static_attrs)
 				{
-					if (
-						member_entry.second[0]->decl_type == MemberType::Field ||
-						member_entry.second[0]->decl_type == MemberType::Property)
-							continue;
-					
 					for (const auto member : member_entry.second)
 					{
-						if (member->decl_type == MemberType::Method && ((MethodInfo*) member)->offset == addr) return member;
-						if (member->decl_type == MemberType::Ctor && ((ConstructorInfo*) member)->offset == addr) return member;
-						if (member->decl_type == MemberType::Dtor && ((DestructorInfo*) member)->offset == addr) return member;
+						if (member->decl_type == MemberType::Method) AddCodeRange(ranges, ((MethodInfo*) member)->offset, member);
+						if (member->decl_type == MemberType::Ctor) AddCodeRange(ranges, ((ConstructorInfo*) member)->offset, member);
+						if (member->decl_type == MemberType::Dtor) AddCodeRange(ranges, ((DestructorInfo*) member)->offset, member);
 					}
 				}
 			}
 		}
 
+		// stable so that the first member registered at an address wins, like the old linear search
+		std::stable_sort(ranges.begin(), ranges.end(), [](const CodeRange& a, const CodeRange& b) { return a.start < b.start; });
+
+		code_ranges = std::move(ranges);
+		code_ranges_dirty = false;
+	}
+
+	void ULRAPIImpl::RegisterStaticRoots(Assembly* assembly)
+	{
+		std::vector<StaticRoot> table;
+
+		for (auto& type_entry : assembly->types)
+		{
+			for (auto& static_entry : type_entry.second->static_attrs)
+			{
+				if (static_entry.second[0]->decl_type != MemberType::Field) continue;
+
+				FieldInfo* field = (FieldInfo*) static_entry.second[0];
+
+				if (!field->offset || !field->valtype) continue; // generic, has no storage of its own
+
+				if (!IsBoxableStruct(field->valtype))
+				{
+					table.push_back({ (char**) field->offset, field });
+					continue;
+				}
+
+				EnsureGCMap(field->valtype);
+
+				for (size_t offset : field->valtype->gc_ptr_offsets) table.push_back({ (char**) (((char*) field->offset)+offset-sizeof(Type*)), field });
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(gc_lock); // not mid-collection
+
+		static_root_tables[assembly] = std::move(table);
+
+		static_roots.clear();
+
+		for (auto& entry : static_root_tables) static_roots.insert(static_roots.end(), entry.second.begin(), entry.second.end());
+	}
+
+	void ULRAPIImpl::UnregisterStaticRoots(Assembly* assembly)
+	{
+		std::lock_guard<std::mutex> lock(gc_lock);
+
+		if (!static_root_tables.erase(assembly)) return;
+
+		static_roots.clear();
+
+		for (auto& entry : static_root_tables) static_roots.insert(static_roots.end(), entry.second.begin(), entry.second.end());
+	}
+
+	void ULRAPIImpl::InvalidateCodeRanges()
+	{
+		std::lock_guard<std::mutex> lock(code_ranges_lock);
+
+		code_ranges_dirty = true;
+		symbols_stale = true; // newly loaded modules have to be picked up by the symbol handler too
+	}
+
+	MemberInfo* ULRAPIImpl::ResolveAddressToMember(void* addr)
+	{
+		std::lock_guard<std::mutex> lock(code_ranges_lock);
+
+		if (code_ranges_dirty) BuildCodeRanges();
+
+		// find the last range starting at or before addr
+		auto after = std::upper_bound(code_ranges.begin(), code_ranges.end(), (char*) addr, [](char* addr, const CodeRange& range) { return addr < range.start; });
+
+		if (after == code_ranges.begin()) return nullptr;
+
+		auto range = after-1;
+
+		// walk back over ranges sharing the same start so that the first one registered is returned
+		while (range != code_ranges.begin() && (range-1)->start == range->start) range--;
+
+		if (range->start == addr || addr < range->end) return range->member;
+
 		return nullptr;
 	}
 
+	MemberInfo* ULRAPIImpl::ResolveReturnAddressToMember(void* addr)
+	{
+		HANDLE proc = GetCurrentProcess();
+
+		RefreshSymbols(proc);
+
+		IMAGEHLP_SYMBOL64 info;
+
+		info.SizeOfStruct = sizeof(info);
+		info.MaxNameLength = 1;
+
+		// functions of native assemblies are registered by their start, JIT compiled code by its whole range
+		if (SymGetSymFromAddr(proc, (DWORD64) addr, NULL, &info)) return ResolveAddressToMember((void*) info.Address);
+
+		return ResolveAddressToMember(addr);
+	}
+
+	void ULRAPIImpl::RefreshSymbols(HANDLE proc)
+	{
+		std::call_once(symbols_initialized, [proc]() { SymInitialize(proc, NULL, true); });
+
+		std::lock_guard<std::mutex> lock(code_ranges_lock);
+
+		if (symbols_stale)
+		{
+			SymRefreshModuleList(proc);
+
+			symbols_stale = false;
+		}
+	}
+
 	std::string ULRAPIImpl::GetFullyQualifiedNameOf(MemberInfo* member)
 	{
 		std::string base = GetDisplayNameOf(member->parent_type);
@@ -981,7 +1830,7 @@ namespace ULR::Resolver
 
 		HANDLE proc = GetCurrentProcess();
 
-		SymInitialize(proc, NULL, true);
+		RefreshSymbols(proc);
 
 		unsigned short num_frames = CaptureStackBackTrace(1+skipframes, MAX_TRACEBACK, bt, NULL);
 
@@ -989,11 +1838,15 @@ namespace ULR::Resolver
 		{
 			IMAGEHLP_SYMBOL64 info;
 
-			if (!SymGetSymFromAddr(proc, (DWORD64) bt[i], NULL, &info)) break;
+			MemberInfo* member;
 
-			void* funcaddr = (void*) info.Address;
+			if (SymGetSymFromAddr(proc, (DWORD64) bt[i], NULL, &info)) member = ResolveAddressToMember((void*) info.Address);
+			else
+			{
+				member = ResolveAddressToMember(bt[i]); // JIT compiled code has no symbols, but its whole range is indexed
 
-			MemberInfo* member = ResolveAddressToMember(funcaddr);
+				if (!member) break;
+			}
 			
 			if (!member)
 			{
@@ -180,7 +180,9 @@ namespace ULR::IL
 	class JITMethodInfo
 	{
 		public:
+			MemberInfo* member;
 			void* addr;
+			size_t size;
 			std::vector<LocalInfo> locals;
 	};
 
@@ -259,5 +261,8 @@ namespace ULR::IL
 			std::string_view LookupString(byte il_of_string_ref[], byte string_ref[]);
 			char* CreateULRString(const char* str, int len);
 			byte* LogMalloc(size_t);
+			void EmitWriteBarrier(std::vector<byte>& code);
+			void EmitSafepointPoll(std::vector<byte>& code); // at calls (and backward jumps, once they are compiled)
+			void EmitAllocateArray(std::vector<byte>& code, Type* array_type, bool align8);
 	};
 }
\ No newline at end of file
@@ -892,6 +892,8 @@ namespace ULR::IL
 					break;
 				case Call:
 					i++; // skip opcode
+
+					EmitSafepointPoll(code); // bounds the time it takes this thread to stop for a collection
 					
 					{
 						bool instance = (il[i] == Flags::Instance); // todo: strict err checking (e.g. is it actually static if not instance)
@@ -1320,7 +1322,7 @@ namespace ULR::IL
 
 							break;
 					}
-				case StFld: // TODO: complete impl
+				case StFld:
 					num_eval_stack_elems-=1; // net change
 
 					i++;
@@ -1344,28 +1346,74 @@ namespace ULR::IL
 
 							if ((field->valtype->decl_type == TypeType::Struct) && (field->valtype->size != 8)) // unfriendly struct types
 							{
-								byte* filled_later;
+								size_t size = field->valtype->size;
 
-								switch (field->valtype->size)
+								if ((size != 1) && (size != 2) && (size != 4) && (size % 8 != 0)) return { "StFld of structs with this size is not supported", CompilationError::ErrorCode::InvalidInstr, &il[i] };
+
+								/*
+									pop rcx
+									mov rax, [filled_later]
+								*/
+								code.push_back(0x59); // pop rcx
+
+								code.insert(code.end(), { 0x48, 0xA1 }); // mov rax,
+
+								byte* filled_later = LogMalloc(sizeof(void*));
+
+								replace_addrs[filled_later] = field;
+
+								code.insert(code.end(), (byte*) &filled_later, ((byte*) &filled_later)+sizeof(byte*)); // [filled_later]
+
+								switch (size)
 								{
 									case 1:
-
+										code.insert(code.end(), { 0x88, 0x08 }); // mov [rax], cl
 										break;
 									case 2:
-								
+										code.insert(code.end(), { 0x66, 0x89, 0x08 }); // mov [rax], cx
 										break;
 									case 4:
-
+										code.insert(code.end(), { 0x89, 0x08 }); // mov [rax], ecx
 										break;
 									default:
+										// rcx holds the addr of the struct (see LdFld), so copy it into the field
+										for (unsigned int stoffset = 0; stoffset < size; stoffset+=8)
+										{
+											/*
+												mov rdx, [rcx+stoffset]
+												mov [rax+stoffset], rdx
+											*/
+
+											code.insert(code.end(), { 0x48, 0x8B, 0x91 });
+											code.insert(code.end(), (byte*) &stoffset, ((byte*) &stoffset)+sizeof(uint32_t));
+
+											code.insert(code.end(), { 0x48, 0x89, 0x90 });
+											code.insert(code.end(), (byte*) &stoffset, ((byte*) &stoffset)+sizeof(uint32_t));
+										}
 
 										break;
 								}
-
 							}
 							else // reference types and 8-byte struct types
 							{
+								/*
+									pop rcx
+									mov rax, [filled_later]
+									mov [rax], rcx
+
+									static fields are GC roots, so no write barrier is needed
+								*/
+								code.push_back(0x59); // pop rcx
+
+								code.insert(code.end(), { 0x48, 0xA1 }); // mov rax,
+
+								byte* filled_later = LogMalloc(sizeof(void*));
+
+								replace_addrs[filled_later] = field;
+
+								code.insert(code.end(), (byte*) &filled_later, ((byte*) &filled_later)+sizeof(byte*)); // [filled_later]
 
+								code.insert(code.end(), { 0x48, 0x89, 0x08 }); // mov [rax], rcx
 							}
 						}
 						else if (binding == Flags::Instance)
@@ -1378,37 +1426,86 @@ namespace ULR::IL
 
 							i+=4; // from string ref
 
-							FieldInfo* field = (FieldInfo*) api->GetType(type_name)->static_attrs[field_name][0];
+							FieldInfo* field = (FieldInfo*) api->GetType(type_name)->inst_attrs[field_name][0];
 
-							// pop the object from the eval stack, add the offset & dereference
+							num_eval_stack_elems-=1; // the object is popped too
+
+							// pop the value & the object from the eval stack, add the offset & store
 
 							uint32_t offset = (uint32_t) ((intptr_t) field->offset);
 
+							// struct field offsets don't take the type ptr of the boxed struct into account (see FieldInfo::GetValue)
+							if (field->parent_type->decl_type == TypeType::Struct) offset+=sizeof(Type*);
+
 							if ((field->valtype->decl_type == TypeType::Struct) && (field->valtype->size != 8)) // unfriendly struct types
 							{
-								switch (field->valtype->size)
+								size_t size = field->valtype->size;
+
+								if ((size != 1) && (size != 2) && (size != 4) && (size % 8 != 0)) return { "StFld of structs with this size is not supported", CompilationError::ErrorCode::InvalidInstr, &il[i] };
+
+								/*
+									pop rax
+									pop rcx
+								*/
+								code.insert(code.end(), { 0x58, 0x59 });
+
+								switch (size)
 								{
 									case 1:
-										
+										code.insert(code.end(), { 0x88, 0x81 }); // mov [rcx+offset], al
+										code.insert(code.end(), (byte*) &offset, ((byte*) &offset)+sizeof(uint32_t));
 										break;
 									case 2:
-										
+										code.insert(code.end(), { 0x66, 0x89, 0x81 }); // mov [rcx+offset], ax
+										code.insert(code.end(), (byte*) &offset, ((byte*) &offset)+sizeof(uint32_t));
 										break;
 									case 4:
-										
+										code.insert(code.end(), { 0x89, 0x81 }); // mov [rcx+offset], eax
+										code.insert(code.end(), (byte*) &offset, ((byte*) &offset)+sizeof(uint32_t));
 										break;
 									default:
+										// rax holds the addr of the struct (see LdFld), so copy it into the field
+										for (unsigned int stoffset = 0; stoffset < size; stoffset+=8)
+										{
+											uint32_t store_offset = offset+stoffset;
+
+											/*
+												mov rdx, [rax+stoffset]
+												mov [rcx+store_offset], rdx
+											*/
+
+											code.insert(code.end(), { 0x48, 0x8B, 0x90 });
+											code.insert(code.end(), (byte*) &stoffset, ((byte*) &stoffset)+sizeof(uint32_t));
+
+											code.insert(code.end(), { 0x48, 0x89, 0x91 });
+											code.insert(code.end(), (byte*) &store_offset, ((byte*) &store_offset)+sizeof(uint32_t));
+										}
+
+										// structs of this assembly don't have their GC maps yet, so they are assumed to hold refs
+										if (!IsBoxableStruct(field->valtype) || !field->valtype->gc_map_built || !field->valtype->gc_ptr_offsets.empty()) EmitWriteBarrier(code);
 
 										break;
 								}
-
 							}
 							else // reference types and 8-byte struct types
 							{
+								/*
+									pop rax
+									pop rcx
+									mov [rcx+offset], rax
+								*/
+								code.insert(code.end(), { 0x58, 0x59 });
 
+								code.insert(code.end(), { 0x48, 0x89, 0x81 });
+								code.insert(code.end(), (byte*) &offset, ((byte*) &offset)+sizeof(uint32_t));
+
+								// structs of this assembly don't have their GC maps yet, so they are assumed to hold refs
+								if (!IsBoxableStruct(field->valtype) || !field->valtype->gc_map_built || !field->valtype->gc_ptr_offsets.empty()) EmitWriteBarrier(code);
 							}
 						}
 					}
+
+					break;
 				case StLoc:
 					num_eval_stack_elems-=1; // net change
 
@@ -1508,6 +1605,52 @@ namespace ULR::IL
 							}
 						}
 					}
+					break;
+				case StElem:
+					num_eval_stack_elems-=3; // net change
+
+					i++;
+
+					{
+						auto type_name = std::string(LookupString(&il[i], string_ref));
+
+						i+=4; // skip string ref
+
+						Type* array_type = internal_api->GetArrayTypePrimarily(type_name+"[]");
+						Type* elem_type = array_type->element_type;
+
+						/*
+							pop rax ; value
+							pop rdx ; index
+							pop rcx ; array
+							movsxd rdx, edx
+						*/
+						code.insert(code.end(), { 0x58, 0x5A, 0x59 });
+						code.insert(code.end(), { 0x48, 0x63, 0xD2 });
+
+						// elements start after the type ptr and the int length
+						switch (array_type->element_storage_size)
+						{
+							case 1:
+								code.insert(code.end(), { 0x88, 0x44, 0x11, 0x0C }); // mov [rcx+rdx+12], al
+								break;
+							case 2:
+								code.insert(code.end(), { 0x66, 0x89, 0x44, 0x51, 0x0C }); // mov [rcx+rdx*2+12], ax
+								break;
+							case 4:
+								code.insert(code.end(), { 0x89, 0x44, 0x91, 0x0C }); // mov [rcx+rdx*4+12], eax
+								break;
+							case 8: // reference types and 8-byte struct types
+								code.insert(code.end(), { 0x48, 0x89, 0x44, 0xD1, 0x0C }); // mov [rcx+rdx*8+12], rax
+								break;
+							default: // TODO: copy larger structs (the value is the address of the struct, like with StLoc)
+								return { "StElem of structs larger than 8 bytes is not supported yet", CompilationError::ErrorCode::InvalidInstr, &il[i] };
+						}
+
+						// structs of this assembly don't have their GC maps yet, so they are assumed to hold refs
+						if (!IsBoxableStruct(elem_type) || !elem_type->gc_map_built || !elem_type->gc_ptr_offsets.empty()) EmitWriteBarrier(code);
+					}
+
 					break;
 				case NewArr:
 					i++;
@@ -1520,18 +1663,10 @@ namespace ULR::IL
 
 						i+=4; // skip string ref
 
-						Type* elem_type = internal_api->GetType(type_name);
 						Type* array_type = internal_api->GetArrayTypePrimarily(type_name+"[]");
 
-						auto allocator = Resolver::ULRAPIImpl::AllocateZeroed;
-						
-						// pop edx [array size now in edx]
-						// mul edx, StorageSize(elem_type) ; add lea optimization later for friendly sizes
-						// add edx, sizeof(Type*)
-						// mov ecx, internal_api
-						// call allocator
-						// mov [eax], array_type
-						// push eax
+						// the length is replaced by the array, so the stack is misaligned for the call when the element count is odd (see Call)
+						EmitAllocateArray(code, array_type, num_eval_stack_elems % 2 != 0);
 					}
 					
 					break;
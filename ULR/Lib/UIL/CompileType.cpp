@@ -128,6 +128,7 @@ namespace ULR::IL
 		}
 
 		meta_asm->types[type->name] = type;
+		api->RegisterType(type);
 
 		i++; // skip EndType signal
 
@@ -189,9 +190,7 @@ namespace ULR::IL
 				{
 					FieldInfo* field = (FieldInfo*) type->static_attrs[name][0];
 
-					void* offset = malloc(
-						GetStorageSizex64(valtype)
-					);
+					void* offset = calloc(1, GetStorageSizex64(valtype)); // zeroed, since collections scan it as soon as the assembly is compiled
 
 					malloc_alloced.push_back(offset);
 
@@ -407,6 +406,8 @@ namespace ULR::IL
 				// TODO: fix when new generic system is impl'd
 				
 				curr_method->offset = funcaddr;
+
+				meta_asm->jit_info->methods.push_back({ curr_method, funcaddr, code.size(), { } });
 			}
 			else return { "Expected field or method declaration signal", CompilationError::ErrorCode::SignalExpected, &il[i] };
 		}
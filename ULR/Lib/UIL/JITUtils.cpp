@@ -1,5 +1,61 @@
 #include "../UIL.hpp"
 
+extern "C" void ULRSafepointSlow()
+{
+	internal_api->Safepoint();
+}
+
+// called by NewArr in JIT code (the length is sign extended from the int on the evaluation stack)
+extern "C" char* ULRAllocateArray(ULR::Resolver::ULRAPIImpl* api, ULR::Type* array_type, int64_t length)
+{
+	if (length < 0) return nullptr; // TODO: have this throw a ULR exc
+
+	return api->AllocateArray(array_type, length);
+}
+
+// called by the safepoint polls in JIT code, which may have any stack alignment and don't expect any register to be clobbered
+extern "C" void ULRSafepointPollStub();
+
+asm(
+	".text\n"
+	".globl ULRSafepointPollStub\n"
+	"ULRSafepointPollStub:\n\t"
+	"push rbp\n\t"
+	"mov rbp, rsp\n\t"
+	"push rax\n\t"
+	"push rcx\n\t"
+	"push rdx\n\t"
+	"push r8\n\t"
+	"push r9\n\t"
+	"push r10\n\t"
+	"push r11\n\t"
+	"and rsp, -16\n\t"
+	"sub rsp, 128\n\t" // shadow space, then xmm0-xmm5 (volatile too, and JIT code may have floats live in them)
+	"movdqa xmmword ptr [rsp+32], xmm0\n\t"
+	"movdqa xmmword ptr [rsp+48], xmm1\n\t"
+	"movdqa xmmword ptr [rsp+64], xmm2\n\t"
+	"movdqa xmmword ptr [rsp+80], xmm3\n\t"
+	"movdqa xmmword ptr [rsp+96], xmm4\n\t"
+	"movdqa xmmword ptr [rsp+112], xmm5\n\t"
+	"call ULRSafepointSlow\n\t"
+	"movdqa xmm0, xmmword ptr [rsp+32]\n\t"
+	"movdqa xmm1, xmmword ptr [rsp+48]\n\t"
+	"movdqa xmm2, xmmword ptr [rsp+64]\n\t"
+	"movdqa xmm3, xmmword ptr [rsp+80]\n\t"
+	"movdqa xmm4, xmmword ptr [rsp+96]\n\t"
+	"movdqa xmm5, xmmword ptr [rsp+112]\n\t"
+	"lea rsp, [rbp-56]\n\t"
+	"pop r11\n\t"
+	"pop r10\n\t"
+	"pop r9\n\t"
+	"pop r8\n\t"
+	"pop rdx\n\t"
+	"pop rcx\n\t"
+	"pop rax\n\t"
+	"pop rbp\n\t"
+	"ret\n"
+);
+
 namespace ULR::IL
 {
 	JITContext::JITContext(Resolver::ULRAPIImpl* api)
@@ -36,6 +92,112 @@ namespace ULR::IL
 		return (char*) str_obj;
 	}
 
+	// emits the inline card-marking barrier for the object in rcx (clobbers r10 & r11)
+	void JITContext::EmitWriteBarrier(std::vector<byte>& code)
+	{
+		char* heap_base = api->heap.base;
+		unsigned char* card_table = api->heap.card_table;
+		uint32_t num_cards = Heap::NUM_CARDS;
+
+		/*
+			mov r10, rcx
+			mov r11, heap_base
+			sub r10, r11
+			shr r10, CARD_SHIFT
+			cmp r10, num_cards
+			jae skip ; not in the segmented heap (a large object or not on the heap at all)
+			mov r11, card_table
+			mov byte ptr [r11+r10], CARD_DIRTY
+			skip:
+		*/
+
+		static_assert(Heap::CARD_SHIFT == 9);
+
+		code.insert(code.end(), { 0x49, 0x89, 0xCA });
+
+		code.insert(code.end(), { 0x49, 0xBB });
+		code.insert(code.end(), (byte*) &heap_base, ((byte*) &heap_base)+sizeof(char*));
+
+		code.insert(code.end(), { 0x4D, 0x29, 0xDA });
+		code.insert(code.end(), { 0x49, 0xC1, 0xEA, 0x09 });
+
+		code.insert(code.end(), { 0x49, 0x81, 0xFA });
+		code.insert(code.end(), (byte*) &num_cards, ((byte*) &num_cards)+sizeof(uint32_t));
+
+		code.insert(code.end(), { 0x73, 0x0F });
+
+		code.insert(code.end(), { 0x49, 0xBB });
+		code.insert(code.end(), (byte*) &card_table, ((byte*) &card_table)+sizeof(unsigned char*));
+
+		code.insert(code.end(), { 0x43, 0xC6, 0x04, 0x13, Heap::CARD_DIRTY });
+	}
+
+	// emits a poll of safepoint_requested that calls into the runtime when a collection is waiting for this thread (clobbers r11)
+	void JITContext::EmitSafepointPoll(std::vector<byte>& code)
+	{
+		std::atomic<bool>* requested = &api->safepoint_requested;
+		void (*stub)() = ULRSafepointPollStub;
+
+		static_assert(sizeof(std::atomic<bool>) == 1);
+
+		/*
+			mov r11, requested
+			cmp byte ptr [r11], 0
+			je skip
+			mov r11, stub
+			call r11
+			skip:
+		*/
+
+		code.insert(code.end(), { 0x49, 0xBB });
+		code.insert(code.end(), (byte*) &requested, ((byte*) &requested)+sizeof(std::atomic<bool>*));
+
+		code.insert(code.end(), { 0x41, 0x80, 0x3B, 0x00 });
+
+		code.insert(code.end(), { 0x74, 0x0D });
+
+		code.insert(code.end(), { 0x49, 0xBB });
+		code.insert(code.end(), (byte*) &stub, ((byte*) &stub)+sizeof(void (*)()));
+
+		code.insert(code.end(), { 0x41, 0xFF, 0xD3 });
+	}
+
+	// emits a call allocating an array of the length on top of the evaluation stack and replaces the length with the array (clobbers the volatile registers)
+	void JITContext::EmitAllocateArray(std::vector<byte>& code, Type* array_type, bool align8)
+	{
+		char* (*allocator)(Resolver::ULRAPIImpl*, Type*, int64_t) = ULRAllocateArray;
+		byte shadow_space = align8 ? 40 : 32;
+
+		/*
+			pop r8
+			movsxd r8, r8d
+			mov rdx, array_type
+			mov rcx, api
+			mov rax, allocator
+			sub rsp, shadow_space
+			call rax
+			add rsp, shadow_space
+			push rax
+		*/
+
+		code.insert(code.end(), { 0x41, 0x58 });
+		code.insert(code.end(), { 0x4D, 0x63, 0xC0 });
+
+		code.insert(code.end(), { 0x48, 0xBA });
+		code.insert(code.end(), (byte*) &array_type, ((byte*) &array_type)+sizeof(Type*));
+
+		code.insert(code.end(), { 0x48, 0xB9 });
+		code.insert(code.end(), (byte*) &api, ((byte*) &api)+sizeof(Resolver::ULRAPIImpl*));
+
+		code.insert(code.end(), { 0x48, 0xB8 });
+		code.insert(code.end(), (byte*) &allocator, ((byte*) &allocator)+sizeof(allocator));
+
+		code.insert(code.end(), { 0x48, 0x83, 0xEC, shadow_space });
+		code.insert(code.end(), { 0xFF, 0xD0 });
+		code.insert(code.end(), { 0x48, 0x83, 0xC4, shadow_space });
+		code.push_back(0x50);
+	}
+
 	byte* JITContext::LogMalloc(size_t size)
 	{
 		void* ptr = malloc(size);
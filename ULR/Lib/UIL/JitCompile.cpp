@@ -22,6 +22,8 @@ namespace ULR::IL
 		std::map<byte*, MemberInfo*> replace_addrs;
 		std::map<MemberInfo*, std::vector<byte>> dynamic_code;
 
+		if (!meta_asm->jit_info) meta_asm->jit_info = new AssemblyJITInfo();
+
 		/* FIRST PASS - MAP OUT ASSEMBLY METADATA */
 		while (il[i] != EndAssembly)
 		{
@@ -64,10 +66,19 @@ namespace ULR::IL
 			if (error) return error;
 		}
 
+		// field offsets are only final once every type has been compiled
+		for (auto& entry : meta_asm->types)
+		{
+			entry.second->Seal();
+		}
+
 		auto error = CompleteCompilation(replace_addrs, dynamic_code, 12); // third pass, offset replace addrs by twelve bytes (12 bytes of prolog) - TODO: find better fix for this
 
 		if (error) return error;
 
+		api->InvalidateCodeRanges();
+		api->RegisterStaticRoots(meta_asm);
+
 		return NoError;
 	}
 
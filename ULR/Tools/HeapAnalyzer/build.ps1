@@ -0,0 +1 @@
+﻿g++64 ulrheap.cpp ../../Lib/HeapSnapshot/HeapSnapshot.cpp -O2 -std=c++17 -o ulrheap.exe
@@ -0,0 +1,462 @@
+// offline analysis of heap snapshots (ULRAPIImpl::WriteHeapSnapshot): retained sizes from the dominator tree, by object, type and static root
+#include "../../Lib/HeapSnapshot.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace ULR::Heap;
+
+const uint32_t NONE = UINT32_MAX;
+const size_t DEFAULT_TOP = 20;
+const size_t MAX_PATH_SHOWN = 8;
+
+// node 0 is a virtual root referencing every root object, node i is object i-1
+struct HeapGraph
+{
+	std::vector<uint64_t> addresses;
+	std::vector<uint32_t> types;
+	std::vector<uint64_t> sizes;
+	std::vector<uint64_t> edge_begin; // into edges, one past the end for the last node
+	std::vector<uint32_t> edges;
+	std::vector<std::string> type_names;
+	std::vector<std::pair<uint32_t, std::string>> static_roots; // node, field
+	size_t num_roots[4] = { };
+
+	size_t NumNodes() { return addresses.size(); }
+};
+
+static bool ReadSnapshot(const char* path, HeapGraph& graph)
+{
+	SnapshotReader reader;
+
+	if (!reader.Open(path))
+	{
+		fprintf(stderr, "%s is not a heap snapshot\n", path);
+
+		return false;
+	}
+
+	std::vector<uint64_t> ref_addresses; // resolved to nodes once every object is known
+	std::vector<std::pair<uint64_t, std::string>> static_roots;
+	std::vector<uint64_t> roots;
+	std::unordered_map<uint64_t, uint32_t> type_index;
+
+	graph.addresses.push_back(0);
+	graph.types.push_back(NONE);
+	graph.sizes.push_back(0);
+	graph.edge_begin.push_back(0); // the root's edges are added last
+
+	graph.type_names.push_back("[no type]");
+
+	SnapshotRecord record;
+
+	while (reader.Next(record))
+	{
+		switch (record.tag)
+		{
+			case SnapshotType:
+				type_index[record.type_id] = graph.type_names.size();
+				graph.type_names.push_back(record.name);
+				break;
+			case SnapshotObject:
+			{
+				auto type = type_index.find(record.type_id);
+
+				graph.addresses.push_back(record.address);
+				graph.types.push_back(type == type_index.end() ? 0 : type->second);
+				graph.sizes.push_back(record.size);
+				graph.edge_begin.push_back(ref_addresses.size());
+
+				ref_addresses.insert(ref_addresses.end(), record.refs.begin(), record.refs.end());
+
+				break;
+			}
+			case SnapshotRoot:
+				if ((size_t) record.root_kind < 4) graph.num_roots[(size_t) record.root_kind]++;
+
+				roots.push_back(record.address);
+
+				if (record.root_kind == RootKind::Static) static_roots.emplace_back(record.address, record.name);
+
+				break;
+			default:
+				break;
+		}
+	}
+
+	if (reader.Malformed())
+	{
+		fprintf(stderr, "%s is truncated or corrupt\n", path);
+
+		return false;
+	}
+
+	// by address, to resolve refs
+	std::vector<uint32_t> by_address(graph.NumNodes()-1);
+
+	for (uint32_t i = 0; i < by_address.size(); i++) by_address[i] = i+1;
+
+	std::sort(by_address.begin(), by_address.end(), [&graph](uint32_t a, uint32_t b) { return graph.addresses[a] < graph.addresses[b]; });
+
+	auto find_node = [&graph, &by_address](uint64_t address) {
+		auto found = std::lower_bound(by_address.begin(), by_address.end(), address, [&graph](uint32_t node, uint64_t address) { return graph.addresses[node] < address; });
+
+		return (found != by_address.end() && graph.addresses[*found] == address) ? *found : NONE;
+	};
+
+	// the root's edges go after the objects' so that edge_begin stays monotonic: node 0's range is [edge_begin[n], end)
+	graph.edges.reserve(ref_addresses.size()+roots.size());
+
+	std::vector<uint64_t> edge_begin(graph.NumNodes()+1);
+
+	for (size_t node = 1; node < graph.NumNodes(); node++)
+	{
+		uint64_t end = (node+1 < graph.NumNodes()) ? graph.edge_begin[node+1] : ref_addresses.size();
+
+		edge_begin[node] = graph.edges.size();
+
+		for (uint64_t i = graph.edge_begin[node]; i < end; i++)
+		{
+			uint32_t target = find_node(ref_addresses[i]);
+
+			if (target != NONE) graph.edges.push_back(target);
+		}
+	}
+
+	ref_addresses.clear();
+	ref_addresses.shrink_to_fit();
+
+	edge_begin[0] = graph.edges.size();
+
+	for (uint64_t root : roots)
+	{
+		uint32_t target = find_node(root);
+
+		if (target != NONE) graph.edges.push_back(target);
+	}
+
+	edge_begin[graph.NumNodes()] = graph.edges.size();
+
+	graph.edge_begin = std::move(edge_begin);
+
+	for (auto& root : static_roots)
+	{
+		uint32_t target = find_node(root.first);
+
+		if (target != NONE) graph.static_roots.emplace_back(target, root.second);
+	}
+
+	return true;
+}
+
+static std::pair<uint64_t, uint64_t> EdgeRange(HeapGraph& graph, uint32_t node)
+{
+	if (node == 0) return { graph.edge_begin[0], graph.edge_begin[graph.NumNodes()] };
+
+	return { graph.edge_begin[node], (node+1 < graph.NumNodes()) ? graph.edge_begin[node+1] : graph.edge_begin[0] };
+}
+
+// Lengauer-Tarjan with path compression, iterative so that long lists don't overflow the stack; unreachable nodes get NONE
+static std::vector<uint32_t> ComputeDominators(HeapGraph& graph, std::vector<uint32_t>& preorder)
+{
+	size_t n = graph.NumNodes();
+
+	std::vector<uint32_t> semi(n, 0), parent(n, NONE), label(n), ancestor(n, NONE), idom(n, NONE), bucket_head(n, NONE), bucket_next(n, NONE);
+
+	preorder.clear();
+	preorder.push_back(NONE); // semi numbers start at 1
+
+	// depth first numbering
+	std::vector<std::pair<uint32_t, uint64_t>> stack = { { 0, EdgeRange(graph, 0).first } };
+
+	semi[0] = 1;
+	label[0] = 0;
+	preorder.push_back(0);
+
+	while (!stack.empty())
+	{
+		auto& top = stack.back();
+		uint64_t end = EdgeRange(graph, top.first).second;
+
+		if (top.second == end)
+		{
+			stack.pop_back();
+			continue;
+		}
+
+		uint32_t next = graph.edges[top.second++];
+
+		if (semi[next]) continue;
+
+		parent[next] = top.first;
+		semi[next] = preorder.size();
+		label[next] = next;
+
+		preorder.push_back(next);
+		stack.emplace_back(next, EdgeRange(graph, next).first);
+	}
+
+	// predecessors of the reached nodes
+	std::vector<uint64_t> pred_begin(n+1, 0);
+	std::vector<uint32_t> preds;
+
+	for (uint32_t node = 0; node < n; node++)
+	{
+		if (!semi[node]) continue;
+
+		auto range = EdgeRange(graph, node);
+
+		for (uint64_t i = range.first; i < range.second; i++) pred_begin[graph.edges[i]+1]++;
+	}
+
+	for (size_t i = 0; i < n; i++) pred_begin[i+1]+=pred_begin[i];
+
+	preds.resize(pred_begin[n]);
+
+	{
+		std::vector<uint64_t> fill(pred_begin.begin(), pred_begin.end()-1);
+
+		for (uint32_t node = 0; node < n; node++)
+		{
+			if (!semi[node]) continue;
+
+			auto range = EdgeRange(graph, node);
+
+			for (uint64_t i = range.first; i < range.second; i++) preds[fill[graph.edges[i]]++] = node;
+		}
+	}
+
+	std::vector<uint32_t> path;
+
+	auto eval = [&](uint32_t v) {
+		if (ancestor[v] == NONE) return v;
+
+		// compress the ancestor chain, closest to the (forest) root first
+		for (uint32_t x = v; ancestor[ancestor[x]] != NONE; x = ancestor[x]) path.push_back(x);
+
+		while (!path.empty())
+		{
+			uint32_t x = path.back();
+
+			path.pop_back();
+
+			if (semi[label[ancestor[x]]] < semi[label[x]]) label[x] = label[ancestor[x]];
+
+			ancestor[x] = ancestor[ancestor[x]];
+		}
+
+		return label[v];
+	};
+
+	for (size_t i = preorder.size()-1; i >= 2; i--)
+	{
+		uint32_t w = preorder[i];
+
+		for (uint64_t p = pred_begin[w]; p < pred_begin[w+1]; p++)
+		{
+			uint32_t u = eval(preds[p]);
+
+			if (semi[u] < semi[w]) semi[w] = semi[u];
+		}
+
+		uint32_t semi_node = preorder[semi[w]];
+
+		bucket_next[w] = bucket_head[semi_node];
+		bucket_head[semi_node] = w;
+
+		ancestor[w] = parent[w];
+
+		for (uint32_t v = bucket_head[parent[w]]; v != NONE; v = bucket_next[v])
+		{
+			uint32_t u = eval(v);
+
+			idom[v] = (semi[u] < semi[v]) ? u : parent[w];
+		}
+
+		bucket_head[parent[w]] = NONE;
+	}
+
+	for (size_t i = 2; i < preorder.size(); i++)
+	{
+		uint32_t w = preorder[i];
+
+		if (idom[w] != preorder[semi[w]]) idom[w] = idom[idom[w]];
+	}
+
+	idom[0] = 0;
+
+	return idom;
+}
+
+static std::string FormatSize(double size)
+{
+	const char* units[] = { "B", "KB", "MB", "GB", "TB" };
+
+	size_t unit = 0;
+
+	while (size >= 1000 && unit < 4)
+	{
+		size/=1000;
+		unit++;
+	}
+
+	char formatted[32];
+
+	snprintf(formatted, sizeof(formatted), unit ? "%.1f %s" : "%.0f %s", size, units[unit]);
+
+	return formatted;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: ulrheap <snapshot> [number of entries per table, %zu by default]\n", DEFAULT_TOP);
+
+		return 1;
+	}
+
+	size_t top = (argc > 2) ? strtoull(argv[2], nullptr, 10) : DEFAULT_TOP;
+
+	HeapGraph graph;
+
+	if (!ReadSnapshot(argv[1], graph)) return 1;
+
+	std::vector<uint32_t> preorder;
+	std::vector<uint32_t> idom = ComputeDominators(graph, preorder);
+
+	size_t n = graph.NumNodes();
+
+	// a node retains itself and everything it dominates, children come after their dominator in preorder
+	std::vector<uint64_t> retained(graph.sizes);
+
+	for (size_t i = preorder.size()-1; i >= 2; i--) retained[idom[preorder[i]]]+=retained[preorder[i]];
+
+	uint64_t total_size = 0;
+
+	for (uint64_t size : graph.sizes) total_size+=size;
+
+	printf(
+		"%zu objects, %s, %zu types\nroots: %zu stack, %zu static, %zu finalizer, %zu handle\nreachable: %zu objects, %s\n\n",
+		n-1, FormatSize(total_size).c_str(), graph.type_names.size()-1,
+		graph.num_roots[(size_t) RootKind::Stack], graph.num_roots[(size_t) RootKind::Static], graph.num_roots[(size_t) RootKind::Finalizer], graph.num_roots[(size_t) RootKind::Handle],
+		preorder.size()-2, FormatSize(retained[0]).c_str()
+	);
+
+	// per type: shallow sizes, and retained sizes counting only the outermost object of a type on each dominator path (nested ones are already included)
+	std::vector<uint64_t> type_count(graph.type_names.size()), type_shallow(graph.type_names.size()), type_retained(graph.type_names.size());
+	std::vector<uint32_t> active(graph.type_names.size());
+
+	{
+		std::vector<uint64_t> child_begin(n+1, 0);
+		std::vector<uint32_t> children;
+
+		for (size_t i = 2; i < preorder.size(); i++) child_begin[idom[preorder[i]]+1]++;
+		for (size_t i = 0; i < n; i++) child_begin[i+1]+=child_begin[i];
+
+		children.resize(child_begin[n]);
+
+		std::vector<uint64_t> fill(child_begin.begin(), child_begin.end()-1);
+
+		for (size_t i = 2; i < preorder.size(); i++) children[fill[idom[preorder[i]]]++] = preorder[i];
+
+		std::vector<std::pair<uint32_t, uint64_t>> stack = { { 0, child_begin[0] } };
+
+		while (!stack.empty())
+		{
+			auto& frame = stack.back();
+
+			if (frame.second == child_begin[frame.first+1])
+			{
+				if (frame.first) active[graph.types[frame.first]]--;
+
+				stack.pop_back();
+				continue;
+			}
+
+			uint32_t child = children[frame.second++];
+			uint32_t type = graph.types[child];
+
+			if (!active[type]++) type_retained[type]+=retained[child];
+
+			stack.emplace_back(child, child_begin[child]);
+		}
+	}
+
+	for (size_t node = 1; node < n; node++)
+	{
+		type_count[graph.types[node]]++;
+		type_shallow[graph.types[node]]+=graph.sizes[node];
+	}
+
+	std::vector<uint32_t> type_order;
+
+	for (uint32_t type = 0; type < graph.type_names.size(); type++)
+	{
+		if (type_count[type]) type_order.push_back(type);
+	}
+
+	std::sort(type_order.begin(), type_order.end(), [&](uint32_t a, uint32_t b) { return type_retained[a] > type_retained[b]; });
+
+	printf("%-12s %-12s %-12s %s\n", "count", "shallow", "retained", "type");
+
+	for (size_t i = 0; i < std::min(top, type_order.size()); i++)
+	{
+		uint32_t type = type_order[i];
+
+		printf("%-12llu %-12s %-12s %s\n", (unsigned long long) type_count[type], FormatSize(type_shallow[type]).c_str(), FormatSize(type_retained[type]).c_str(), graph.type_names[type].c_str());
+	}
+
+	// largest objects by retained size, with their dominator path
+	std::vector<uint32_t> objects;
+
+	for (size_t i = 2; i < preorder.size(); i++) objects.push_back(preorder[i]);
+
+	size_t shown = std::min(top, objects.size());
+
+	std::partial_sort(objects.begin(), objects.begin()+shown, objects.end(), [&retained](uint32_t a, uint32_t b) { return retained[a] > retained[b]; });
+
+	printf("\n%-20s %-12s %-12s %s\n", "object", "shallow", "retained", "type <- dominators");
+
+	for (size_t i = 0; i < shown; i++)
+	{
+		uint32_t node = objects[i];
+
+		printf("0x%-18llx %-12s %-12s %s", (unsigned long long) graph.addresses[node], FormatSize(graph.sizes[node]).c_str(), FormatSize(retained[node]).c_str(), graph.type_names[graph.types[node]].c_str());
+
+		size_t depth = 0;
+
+		for (uint32_t dom = idom[node]; dom != 0; dom = idom[dom])
+		{
+			if (++depth > MAX_PATH_SHOWN)
+			{
+				printf(" <- ...");
+				break;
+			}
+
+			printf(" <- %s", graph.type_names[graph.types[dom]].c_str());
+		}
+
+		printf(" <- [root]\n");
+	}
+
+	if (graph.static_roots.empty()) return 0;
+
+	// static fields by what they keep alive
+	std::sort(graph.static_roots.begin(), graph.static_roots.end(), [&retained](auto& a, auto& b) { return retained[a.first] > retained[b.first]; });
+
+	printf("\n%-12s %s\n", "retained", "static field");
+
+	for (size_t i = 0; i < std::min(top, graph.static_roots.size()); i++)
+	{
+		auto& root = graph.static_roots[i];
+
+		// an object also reachable from elsewhere is only retained by the virtual root, so this is what the field holds, not what it alone keeps alive
+		printf("%-12s %s\n", FormatSize(retained[root.first]).c_str(), root.second.c_str());
+	}
+
+	return 0;
+}
@@ -24,6 +24,39 @@ public class Program
 	
 		[Option('a', "args", HelpText = "Arguments to pass to program")]
 		public IEnumerable<string> ProgramArguments { get; set; } = [];
+
+		[Option("gc-mode", HelpText = "GC policy: throughput or latency (sets ULR_GC_MODE)")]
+		public string? GCMode { get; set; }
+
+		[Option("gc-growth", HelpText = "Heap growth factor over the live size between full collections (sets ULR_GC_GROWTH)")]
+		public string? GCGrowth { get; set; }
+
+		[Option("gc-heap-limit", HelpText = "Hard heap limit in bytes, accepts a k/m/g suffix (sets ULR_GC_HEAP_LIMIT)")]
+		public string? GCHeapLimit { get; set; }
+
+		[Option("gc-nursery", HelpText = "Nursery size in bytes, accepts a k/m/g suffix (sets ULR_GC_NURSERY)")]
+		public string? GCNursery { get; set; }
+
+		[Option("gc-workers", HelpText = "Number of parallel marking threads, 0 for one per core (sets ULR_GC_WORKERS)")]
+		public string? GCWorkers { get; set; }
+
+		[Option("alloc-profile", HelpText = "Sample allocations and write a pprof profile (or folded stacks, for a .folded file) to this file at exit (sets ULR_ALLOC_PROFILE)")]
+		public string? AllocProfile { get; set; }
+
+		[Option("alloc-profile-interval", HelpText = "Average number of bytes allocated between samples (sets ULR_ALLOC_PROFILE_INTERVAL)")]
+		public string? AllocProfileInterval { get; set; }
+	}
+
+	// the runtime reads its GC configuration from the environment, so the options only override inherited variables
+	static void SetGCEnvironment(Options options)
+	{
+		if (options.GCMode is not null) Environment.SetEnvironmentVariable("ULR_GC_MODE", options.GCMode);
+		if (options.GCGrowth is not null) Environment.SetEnvironmentVariable("ULR_GC_GROWTH", options.GCGrowth);
+		if (options.GCHeapLimit is not null) Environment.SetEnvironmentVariable("ULR_GC_HEAP_LIMIT", options.GCHeapLimit);
+		if (options.GCNursery is not null) Environment.SetEnvironmentVariable("ULR_GC_NURSERY", options.GCNursery);
+		if (options.GCWorkers is not null) Environment.SetEnvironmentVariable("ULR_GC_WORKERS", options.GCWorkers);
+		if (options.AllocProfile is not null) Environment.SetEnvironmentVariable("ULR_ALLOC_PROFILE", options.AllocProfile);
+		if (options.AllocProfileInterval is not null) Environment.SetEnvironmentVariable("ULR_ALLOC_PROFILE_INTERVAL", options.AllocProfileInterval);
 	}
 
 	static int Main(string[] args)
@@ -33,6 +66,8 @@ public class Program
 			.WithParsed((options) => {
 				int ret;
 
+				SetGCEnvironment(options);
+
 				if (options.UseNativeAssembly)
 				{
 					ret = ULRHost.HostNative(
@@ -9,6 +9,7 @@
 #include <locale>
 #include <string>
 #include <csignal>
+#include <fstream>
 #include <Windows.h>
 #include <dbghelp.h>
 
@@ -47,6 +48,46 @@ void handle_access_violation(int signo)
 		<< internal_api->GetStackTrace(2);
 }
 
+// ULR_ALLOC_PROFILE=<file> turns on the allocation profiler, sampling on average every ULR_ALLOC_PROFILE_INTERVAL bytes (512 KiB by default)
+bool start_allocation_profiler(ULRAPIImpl& api, std::string& profile_path)
+{
+	char value[MAX_PATH];
+
+	DWORD len = GetEnvironmentVariableA("ULR_ALLOC_PROFILE", value, sizeof(value));
+
+	if (!len || len >= sizeof(value)) return false;
+
+	profile_path = value;
+
+	size_t interval = 512*1024;
+
+	len = GetEnvironmentVariableA("ULR_ALLOC_PROFILE_INTERVAL", value, sizeof(value));
+
+	if (len && len < sizeof(value)) interval = strtoull(value, nullptr, 10);
+
+	api.allocation_profiler.Start(interval);
+
+	return true;
+}
+
+// folded stacks if the file ends in .folded, pprof otherwise
+void write_allocation_profile(ULRAPIImpl& api, std::string& profile_path)
+{
+	api.allocation_profiler.Stop();
+
+	std::ofstream out(profile_path, std::ios::binary);
+
+	if (!out)
+	{
+		std::cerr << "Could not write the allocation profile to " << profile_path << '\n';
+
+		return;
+	}
+
+	if (profile_path.size() >= 7 && profile_path.compare(profile_path.size()-7, 7, ".folded") == 0) api.allocation_profiler.WriteFolded(out);
+	else api.allocation_profiler.WritePprof(out);
+}
+
 struct HostingResult // this implementation is not exposed to the caller of HostXXXXAssembly(), so no fields are public 
 {
 	int retcode;
@@ -75,6 +116,7 @@ extern "C" HostingResult HostNativeAssembly(
 	ULRAPIImpl lclapi = ULRAPIImpl( // perhaps refactor Loader into an object someday
 		&Loader::LoadedAssemblies,
 		&Loader::ReadAssemblies,
+		&Loader::TypeIndex,
 		Loader::ReadNativeAssembly,
 		Loader::LoadNativeAssembly,
 		Loader::PopulateVtable,
@@ -132,23 +174,26 @@ extern "C" HostingResult HostNativeAssembly(
 	
 	lclapi.InitGCLocalVarRoot((char**) &retcode);
 
+	std::string profile_path;
+
+	bool profiling = start_allocation_profiler(lclapi, profile_path);
+
 	retcode = mainasm->entry(ulr_args_arr_obj);
 
+	if (profiling) write_allocation_profile(lclapi, profile_path); // while the types (and their names) are still around
 	
 	// Final deallocation and cleanup (of ULR objects and the allocated assemblies)
 
-	for (auto& entry : lclapi.allocated_objs)
-	{		
-		free(entry.first);
-	}
-
-	lclapi.allocated_size = 0;
+	lclapi.StopFinalizerThread();
+	lclapi.heap.Release();
 
 	for (void* ptr : lclapi.allocated_field_offsets)
 	{
 		free(ptr);
 	}
 
+	Loader::TypeIndex.clear(); // the indexed names are owned by the types deleted below
+
 	std::set<Assembly*> allocated_asms;
 
 	for (auto& entry : Loader::ReadAssemblies) allocated_asms.emplace(entry.second);
@@ -156,6 +201,8 @@ extern "C" HostingResult HostNativeAssembly(
 
 	for (auto allocated_assembly : allocated_asms)
 	{
+		lclapi.UnregisterStaticRoots(allocated_assembly);
+
 		delete allocated_assembly;
 	}
 